@@ -0,0 +1,239 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   bench.h                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 18:05:52 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 18:40:10 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+#endif
+
+#include "malloc_cycles.h"
+
+// Helpers shared by the benchmark programs in tests/ (header only: each bench
+// is a single translation unit linked against libc or libft_malloc, built
+// with _DEFAULT_SOURCE for syscall()).
+
+// Present in libft_malloc only: tells which allocator a bench binary runs on.
+extern void show_alloc_mem(void) __attribute__((weak));
+
+static inline const char *bench_allocator(void)
+{
+	return show_alloc_mem ? "custom" : "libc";
+}
+
+static inline double bench_now_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// malloc_cycles() ticks per nanosecond, measured over ~20 ms.
+static inline double bench_ticks_per_ns(void)
+{
+	double t0 = bench_now_sec();
+	uint64_t c0 = malloc_cycles();
+	while (bench_now_sec() - t0 < 0.02)
+		;
+	double t1 = bench_now_sec();
+	uint64_t c1 = malloc_cycles();
+	return (double)(c1 - c0) / ((t1 - t0) * 1e9);
+}
+
+// Log-linear latency histogram: 8 linear sub-buckets per power of two, so a
+// percentile is within 12.5% of the true value whatever the magnitude.
+#define BENCH_HIST_SUB 8
+#define BENCH_HIST_BUCKETS (64 * BENCH_HIST_SUB)
+
+typedef struct s_bench_hist
+{
+	uint64_t count;
+	uint64_t max;
+	uint64_t sum;
+	uint64_t bucket[BENCH_HIST_BUCKETS];
+} t_bench_hist;
+
+static inline unsigned bench_hist_index(uint64_t v)
+{
+	if (v < BENCH_HIST_SUB)
+		return (unsigned)v;
+	unsigned k = 63U - (unsigned)__builtin_clzll(v); // v in [2^k, 2^(k+1))
+	unsigned sub = (unsigned)((v >> (k - 3)) & (BENCH_HIST_SUB - 1));
+	return (k - 2) * BENCH_HIST_SUB + sub;
+}
+
+// Lower bound of bucket i (inverse of bench_hist_index).
+static inline uint64_t bench_hist_value(unsigned i)
+{
+	if (i < 2 * BENCH_HIST_SUB)
+		return i;
+	unsigned k = i / BENCH_HIST_SUB + 2;
+	return ((uint64_t)1 << k) | ((uint64_t)(i % BENCH_HIST_SUB) << (k - 3));
+}
+
+static inline void bench_hist_add(t_bench_hist *h, uint64_t v)
+{
+	h->count++;
+	h->sum += v;
+	if (v > h->max)
+		h->max = v;
+	h->bucket[bench_hist_index(v)]++;
+}
+
+static inline uint64_t bench_hist_percentile(const t_bench_hist *h, double q)
+{
+	uint64_t rank = (uint64_t)(q * (double)h->count);
+	uint64_t seen = 0;
+	for (unsigned i = 0; i < BENCH_HIST_BUCKETS; ++i)
+	{
+		seen += h->bucket[i];
+		if (seen > rank)
+			return bench_hist_value(i);
+	}
+	return h->max;
+}
+
+// Hardware counters around a measured region (perf_event_open, Linux).
+// Each event is opened on its own, user space only, inherited by threads
+// created afterwards; an event the kernel or the CPU refuses (no PMU in a VM,
+// perf_event_paranoid, other OS) is reported as n/a, the run goes on.
+#define BENCH_PERF_EVENTS 7
+
+typedef struct s_bench_perf
+{
+	int fd[BENCH_PERF_EVENTS];
+	uint64_t value[BENCH_PERF_EVENTS]; // scaled when the kernel multiplexed the event
+} t_bench_perf;
+
+static const char *const g_bench_perf_names[BENCH_PERF_EVENTS] = {
+	"instructions", "cycles", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses", "page_faults"};
+
+#ifdef __linux__
+static inline void bench_perf_event(int idx, struct perf_event_attr *attr)
+{
+	static const uint64_t cache_read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	const uint32_t types[BENCH_PERF_EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+											   PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE,
+											   PERF_TYPE_SOFTWARE};
+	const uint64_t configs[BENCH_PERF_EVENTS] = {PERF_COUNT_HW_INSTRUCTIONS,
+												 PERF_COUNT_HW_CPU_CYCLES,
+												 PERF_COUNT_HW_CACHE_L1D | cache_read_miss,
+												 PERF_COUNT_HW_CACHE_LL | cache_read_miss,
+												 PERF_COUNT_HW_CACHE_DTLB | cache_read_miss,
+												 PERF_COUNT_HW_BRANCH_MISSES,
+												 PERF_COUNT_SW_PAGE_FAULTS};
+	attr->type = types[idx];
+	attr->config = configs[idx];
+}
+
+static inline void bench_perf_open(t_bench_perf *p)
+{
+	memset(p, 0, sizeof(*p));
+	for (int i = 0; i < BENCH_PERF_EVENTS; ++i)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		bench_perf_event(i, &attr);
+		attr.disabled = 1;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		p->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+}
+
+static inline void bench_perf_start(t_bench_perf *p)
+{
+	for (int i = 0; i < BENCH_PERF_EVENTS; ++i)
+		if (p->fd[i] >= 0)
+		{
+			ioctl(p->fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(p->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+}
+
+static inline void bench_perf_stop(t_bench_perf *p)
+{
+	for (int i = 0; i < BENCH_PERF_EVENTS; ++i)
+	{
+		uint64_t v[3] = {0, 0, 0}; // value, time enabled, time running
+		p->value[i] = 0;
+		if (p->fd[i] < 0)
+			continue;
+		ioctl(p->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+		if (read(p->fd[i], v, sizeof(v)) != (ssize_t)sizeof(v))
+			continue;
+		p->value[i] = (v[2] && v[2] < v[1]) ? (uint64_t)((double)v[0] * (double)v[1] / (double)v[2]) : v[0];
+	}
+}
+
+static inline void bench_perf_close(t_bench_perf *p)
+{
+	for (int i = 0; i < BENCH_PERF_EVENTS; ++i)
+		if (p->fd[i] >= 0)
+			close(p->fd[i]);
+}
+#else
+static inline void bench_perf_open(t_bench_perf *p)
+{
+	memset(p, 0, sizeof(*p));
+	for (int i = 0; i < BENCH_PERF_EVENTS; ++i)
+		p->fd[i] = -1;
+}
+static inline void bench_perf_start(t_bench_perf *p) { (void)p; }
+static inline void bench_perf_stop(t_bench_perf *p) { (void)p; }
+static inline void bench_perf_close(t_bench_perf *p) { (void)p; }
+#endif
+
+// "name=value/op ..." (or name=n/a) on one line, after `prefix`.
+static inline void bench_perf_print(const t_bench_perf *p, const char *prefix, double ops)
+{
+	printf("%s", prefix);
+	for (int i = 0; i < BENCH_PERF_EVENTS; ++i)
+	{
+		if (p->fd[i] < 0)
+			printf(" %s=n/a", g_bench_perf_names[i]);
+		else
+			printf(" %s=%.3f", g_bench_perf_names[i], ops > 0 ? (double)p->value[i] / ops : 0.0);
+	}
+	printf(" (per op)\n");
+}
+
+// CSV fields ",v1,v2,..." per op (empty when unavailable); header via bench_perf_csv_header.
+static inline void bench_perf_csv(const t_bench_perf *p, double ops)
+{
+	for (int i = 0; i < BENCH_PERF_EVENTS; ++i)
+	{
+		if (p->fd[i] < 0)
+			printf(",");
+		else
+			printf(",%.3f", ops > 0 ? (double)p->value[i] / ops : 0.0);
+	}
+}
+
+static inline void bench_perf_csv_header(void)
+{
+	for (int i = 0; i < BENCH_PERF_EVENTS; ++i)
+		printf(",%s", g_bench_perf_names[i]);
+}
+
+#endif
@@ -6,7 +6,7 @@
 /*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2025/09/24 15:27:53 by tamigore          #+#    #+#             */
-/*   Updated: 2025/09/27 13:16:07 by tamigore         ###   ########.fr       */
+/*   Updated: 2026/10/19 21:58:40 by tamigore         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
@@ -23,12 +23,27 @@
 #endif
 
 #include "malloc_blocks.h"
+#include "malloc_class.h"
 #include "malloc_debug.h"
 #include "malloc_bin.h"
 #include "malloc_pthread.h"
+#include "malloc_stats.h"
+#include "malloc_profile.h"
+#include "malloc_show.h"
+#include "malloc_frag.h"
+#include "malloc_trace.h"
+#include "malloc_reserve.h"
+#include "malloc_large.h"
 
 inline static t_block *ptr_to_block(void *ptr)
 {
+	// Only LARGE payloads start a page and have their header elsewhere.
+	if (((uintptr_t)ptr & (MALLOC_LARGE_GRAIN - 1)) == 0)
+	{
+		t_block *b = malloc_large_find(ptr);
+		if (b)
+			return b;
+	}
 	return (t_block *)((char *)ptr - sizeof(t_block));
 }
 
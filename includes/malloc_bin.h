@@ -6,19 +6,39 @@
 /*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2025/09/24 15:26:53 by tamigore          #+#    #+#             */
-/*   Updated: 2025/09/27 14:05:11 by tamigore         ###   ########.fr       */
+/*   Updated: 2026/10/20 10:04:12 by tamigore         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
 #ifndef MALLOC_BIN_H
 #define MALLOC_BIN_H
 
-#include "malloc_blocks.h"
+#include "malloc_class.h"
 
 // Segregated bins API
 // Filter by desired zone type to prevent cross-class reuse (e.g., tiny request reusing small block)
 t_block *malloc_bin_take(size_t size, t_zone_type type);
 void malloc_bin_insert(t_block *b);
 void malloc_bin_remove(t_block *b);
+// Read-only walk of the bins (allocator mutex held): 0 / NULL before the first
+// insert. Bins of a type are indexed by size class (malloc_class.h). The last
+// bin stays empty: free blocks of its class and above are in a best-fit tree,
+// visited in (size, address) order by malloc_bin_tree_walk().
+size_t malloc_bin_count(void);
+const t_block *malloc_bin_head(t_zone_type type, size_t idx);
+void malloc_bin_tree_walk(t_zone_type type, void (*fn)(const t_block *, void *), void *arg);
+
+// Quick lists (free.c, allocator mutex held): free() parks a TINY/SMALL block
+// of up to MALLOC_QUICK_MAX_SIZE bytes, unmerged, on a LIFO list of its class,
+// and the next request of the class takes it back as is. Coalescing and
+// binning run in bulk in malloc_quick_flush(): when an allocation finds no
+// bin and when more than MALLOC_QUICK_LIMIT blocks are parked. Heap inspection
+// (show, stats, frag) counts parked blocks as free in place.
+#define MALLOC_QUICK_MAX_SIZE 1024UL
+#define MALLOC_QUICK_LIMIT 256
+t_block *malloc_quick_take(size_t size, t_zone_type type);
+// Number of blocks released to the bins.
+size_t malloc_quick_flush(void);
+const t_block *malloc_quick_head(t_zone_type type, size_t cls);
 
 #endif
\ No newline at end of file
@@ -6,7 +6,7 @@
 /*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2025/09/24 15:26:56 by tamigore          #+#    #+#             */
-/*   Updated: 2025/09/27 12:55:12 by tamigore         ###   ########.fr       */
+/*   Updated: 2026/10/20 10:04:12 by tamigore         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
@@ -30,9 +30,19 @@ typedef enum e_zone_type
 // TINY_MAX / SMALL_MAX remain unchanged while ensuring page-size multiples.
 size_t malloc_tiny_max(void);
 size_t malloc_small_max(void);
+size_t malloc_pagesize(void);
+char *zone_type_to_string(t_zone_type t);
 #define TINY_MAX (malloc_tiny_max())
 #define SMALL_MAX (malloc_small_max())
 
+// TINY/SMALL zones grow geometrically: the first zone of a type holds
+// MALLOC_ZONE_FIRST_BLOCKS maximal blocks, each next one is twice the previous
+// up to MALLOC_ZONE_MAX_SIZE bytes (make ZONE_MAX=<bytes>).
+#define MALLOC_ZONE_FIRST_BLOCKS 16
+#ifndef MALLOC_ZONE_MAX_SIZE
+#define MALLOC_ZONE_MAX_SIZE (4UL << 20)
+#endif
+
 // Forward declaration for t_block
 struct s_zone;
 
@@ -47,8 +57,14 @@ typedef struct s_block
 	struct s_block *bin_prev; // prev in size-class free list
 	struct s_zone *zone;	  // owning zone back-pointer
 	char free;				  // free flag
+	unsigned char flags;	  // BLOCK_F_* bits (fits in header padding)
 } __attribute__((aligned(16))) t_block;
 
+// t_block.flags bits
+#define BLOCK_F_CACHED 0x01	 // parked in a per-CPU cache (still counted as used)
+#define BLOCK_F_SAMPLED 0x02 // recorded by the heap profiler
+#define BLOCK_F_QUICK 0x04	 // parked on a quick list, not merged yet (free stays 0)
+
 typedef struct s_zone
 {
 	t_zone_type type;
@@ -56,14 +72,39 @@ typedef struct s_zone
 	size_t used;		 // sum of allocated payload sizes
 	size_t data_offset;	 // aligned offset to first block area
 	struct s_zone *next; // next zone
+	struct s_zone *prev; // previous zone (O(1) unlink of LARGE zones)
 	t_block *blocks;	 // first block
 	t_block *tail;		 // last block
-	// Bin metadata (stored in one arbitrary zone to avoid extra global vars)
-	t_block **bins;      // dynamic array of bin heads
-	size_t bin_count;    // number of bins
 } t_zone;
 
+// Free as far as heap inspection goes: released, or parked on a quick list.
+static inline int block_is_free(const t_block *b)
+{
+	return b->free || (b->flags & BLOCK_F_QUICK);
+}
+
 // Global head of all zones
 extern t_zone *g_zones;
 
+// Push a zone at the head of g_zones / unlink it (allocator mutex held).
+static inline void zone_link(t_zone *z)
+{
+	z->prev = NULL;
+	z->next = g_zones;
+	if (g_zones)
+		g_zones->prev = z;
+	g_zones = z;
+}
+
+static inline void zone_unlink(t_zone *z)
+{
+	if (z->prev)
+		z->prev->next = z->next;
+	else if (g_zones == z)
+		g_zones = z->next;
+	if (z->next)
+		z->next->prev = z->prev;
+	z->next = z->prev = NULL;
+}
+
 #endif
@@ -0,0 +1,39 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_class.h                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 19:48:26 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 19:48:26 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_CLASS_H
+#define MALLOC_CLASS_H
+
+#include "malloc_blocks.h"
+
+// Size classes of TINY and SMALL blocks: 16-byte steps up to
+// MALLOC_CLASS_LINEAR_MAX, then MALLOC_CLASS_STEPS classes per power of two
+// (160, 192, 224, 256, 320, ...). Requests are rounded up to their class: at
+// most 15 bytes are lost below MALLOC_CLASS_LINEAR_MAX and less than 20% of the
+// block above, and a freed block is reused as is by the next request of its
+// class.
+#define MALLOC_CLASS_LINEAR_MAX 128UL
+#define MALLOC_CLASS_LINEAR_SHIFT 7 // log2(MALLOC_CLASS_LINEAR_MAX)
+#define MALLOC_CLASS_STEPS_SHIFT 2	// MALLOC_CLASS_STEPS = 4
+#define MALLOC_CLASS_STEPS (1UL << MALLOC_CLASS_STEPS_SHIFT)
+#define MALLOC_CLASS_LINEAR (MALLOC_CLASS_LINEAR_MAX / MALLOC_ALIGN) // classes of the linear part
+#define MALLOC_CLASS_MAX 60 // classes up to 1 MiB; SMALL_MAX uses malloc_class_count() of them
+
+// Smallest class holding `size` bytes (1 <= size <= 1 MiB).
+size_t malloc_class_index(size_t size);
+// Largest class a free block of `size` bytes can serve.
+size_t malloc_class_floor(size_t size);
+size_t malloc_class_size(size_t idx);
+// Classes up to SMALL_MAX (the bins of one zone type).
+size_t malloc_class_count(void);
+
+#endif
@@ -0,0 +1,45 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_cycles.h                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 11:40:27 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 11:40:27 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_CYCLES_H
+#define MALLOC_CYCLES_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Cheap monotonic tick counter for instrumentation (TSC / virtual counter).
+// Units are CPU-specific; only differences are meaningful.
+static inline uint64_t malloc_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+	uint64_t v;
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(v));
+	return v;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Bucket index for log2 histograms: bucket k holds values in [2^k, 2^(k+1)).
+static inline unsigned malloc_log2_bucket(uint64_t v, unsigned buckets)
+{
+	unsigned k = 63U - (unsigned)__builtin_clzll(v | 1);
+	return k < buckets ? k : buckets - 1;
+}
+
+#endif
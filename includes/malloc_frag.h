@@ -0,0 +1,53 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_frag.h                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 15:40:27 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 15:40:27 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_FRAG_H
+#define MALLOC_FRAG_H
+
+#include "malloc_stats.h"
+
+// Fragmentation report, computed on read from the zone block lists and the
+// free bins (no build flag needed). Free bytes only count free blocks; the
+// never-used end of a zone is reported separately as tail slack.
+#define MALLOC_FRAG_BINS MALLOC_STATS_CLASSES // one histogram entry per bin
+
+typedef struct s_malloc_frag_type
+{
+	size_t zones;
+	size_t capacity;		// data bytes of those zones
+	size_t live_blocks;		// blocks in use (per-CPU cached ones included)
+	size_t live_bytes;		// aligned payload bytes of live blocks
+	size_t requested_bytes; // bytes asked for by callers for live blocks
+	size_t internal;		// live_bytes - requested_bytes
+	size_t free_blocks;
+	size_t free_bytes; // payload bytes of free blocks
+	size_t largest_free;
+	size_t tail_slack;	  // bytes after each zone's last block, never handed out
+	double external;	  // 1 - largest_free / free_bytes (0 when nothing is free)
+	double internal_ratio; // internal / live_bytes
+	double tail_share;	  // tail_slack / capacity
+	size_t bin_size[MALLOC_FRAG_BINS];	   // smallest block a bin holds (its size class)
+	uint64_t bin_blocks[MALLOC_FRAG_BINS]; // free blocks found in each bin
+	uint64_t bin_bytes[MALLOC_FRAG_BINS];
+} t_malloc_frag_type;
+
+typedef struct s_malloc_frag
+{
+	t_malloc_frag_type types[3]; // by t_zone_type
+} t_malloc_frag;
+
+// Fill `out`. Returns 0, or -1 when out is NULL.
+int malloc_frag_get(t_malloc_frag *out);
+// Print the per-type figures and non-empty bins on stdout.
+void malloc_frag_report(void);
+
+#endif
@@ -0,0 +1,70 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_large.h                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 21:58:40 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 11:08:44 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_LARGE_H
+#define MALLOC_LARGE_H
+
+#include "malloc_blocks.h"
+
+// LARGE blocks map exactly ALIGN_UP(size, page) bytes and their payload is the
+// start of the mapping (page-aligned, O_DIRECT friendly). The t_zone / t_block
+// headers live out of line in a t_large record, found from the payload through
+// a two-level page map keyed by its 4 KiB page number. LARGE zones have
+// data_offset 0 and capacity the mapping size; use zone_base() / block_payload()
+// rather than header arithmetic for them.
+//
+// Up to MALLOC_MEDIUM_MAX the mapping is a page run carved from a
+// MALLOC_MEDIUM_CHUNK chunk instead of a mapping of its own. Free runs are
+// kept by page count, split on allocation and merged with their free
+// neighbours (found through the page map, which also records the last page of
+// every run); a chunk that is entirely free again is unmapped.
+#define MALLOC_LARGE_GRAIN 4096UL // page map key granularity (divides any page size)
+#define MALLOC_LARGE_LEAF_BITS 18
+#define MALLOC_MEDIUM_MAX (1UL << 20)
+#define MALLOC_MEDIUM_CHUNK (8UL << 20)
+
+typedef struct s_large
+{
+	t_zone zone; // first: a LARGE t_zone * is a t_large *
+	t_block block;
+	void *map;				   // payload == mapping / run start
+	char *chunk;			   // medium: owning chunk, NULL for a mapping of its own
+	struct s_large *run_next;  // free run lists (medium), record free list
+	struct s_large *run_prev;
+} t_large;
+
+// Map and register a LARGE block (allocator mutex held); NULL on failure.
+t_block *malloc_large_alloc(size_t size, size_t requested);
+// Unregister, unlink and unmap a LARGE block (allocator mutex held).
+void malloc_large_free(t_block *b);
+// Header of the LARGE block whose payload is `ptr`, NULL otherwise. Lock-free:
+// page map levels are never freed and a live block's entry is stable.
+t_block *malloc_large_find(const void *ptr);
+// Whether `ptr` is a page the page map knows but no live LARGE block starts
+// at: a released (possibly merged) medium run, or a page inside a run. free()
+// rejects it like a TINY/SMALL block already free (allocator mutex held).
+int malloc_large_stale(const void *ptr);
+
+// First byte of the memory a zone describes (the mapping for LARGE).
+static inline char *zone_base(const t_zone *z)
+{
+	return z->type == ZONE_LARGE ? (char *)((const t_large *)z)->map : (char *)z;
+}
+
+static inline void *block_payload(const t_block *b)
+{
+	if (b->zone && b->zone->type == ZONE_LARGE)
+		return ((const t_large *)b->zone)->map;
+	return (char *)b + sizeof(t_block);
+}
+
+#endif
@@ -0,0 +1,56 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_percpu.h                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 10:02:11 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 14:41:50 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_PERCPU_H
+#define MALLOC_PERCPU_H
+
+#include "malloc_class.h"
+
+// Per-CPU object caches (optional, build with `make PERCPU=1`).
+// Each CPU owns a small stack of cached blocks per size class (malloc_class.h)
+// up to PERCPU_MAX_SIZE. Push/pop run as Linux restartable sequences (rseq) so they
+// need neither the allocator mutex nor atomics. Both calls return 0/NULL when
+// the fast path is unavailable (no rseq, size out of range, heap exhausted)
+// and the caller falls back to the locked bin path.
+//
+// Magazines: a CPU stack holds two magazines of PERCPU_MAG_SIZE objects (the
+// loaded one and the previous one). An empty stack takes a full magazine from
+// the depot, or has one filled from the heap in one allocator-lock trip. A full
+// stack hands a magazine of its objects to the depot. The depot keeps at most
+// PERCPU_DEPOT_MAGS full magazines per class behind its own short lock, and
+// gives the objects of any extra one back to the heap in one lock trip.
+// A class caches at most ncpu * PERCPU_DEPTH + PERCPU_DEPOT_MAGS * PERCPU_MAG_SIZE objects.
+#define PERCPU_MAX_SHIFT 10
+#define PERCPU_MAX_SIZE (1UL << PERCPU_MAX_SHIFT)
+#define PERCPU_CLASSES 20 // malloc_class_index(PERCPU_MAX_SIZE) + 1, checked in percpu.c
+#define PERCPU_MAG_SIZE 16
+#define PERCPU_DEPTH (2 * PERCPU_MAG_SIZE)
+#define PERCPU_DEPOT_MAGS 8
+
+#ifdef MALLOC_PERCPU
+void *malloc_percpu_pop(size_t size);
+int malloc_percpu_push(void *ptr);
+// Give the objects cached on the calling CPU and in the depot back to the heap
+// (tests: lets freed blocks reach the quick lists and the bins).
+void malloc_percpu_drain(void);
+// Heap side of the magazines: fill `out` with up to `n` BLOCK_F_CACHED blocks
+// of `size` bytes (malloc.c) / give cached blocks back (free.c), each under
+// one allocator lock. Neither is counted in the statistics.
+size_t malloc_cache_fill(size_t size, void **out, size_t n);
+void malloc_cache_release(void **objs, size_t n);
+# ifdef MALLOC_STATS
+// Sum of the per-CPU pop (hits) / push (returns) counters, PERCPU_CLASSES entries each.
+void malloc_percpu_stats(uint64_t *hits, uint64_t *returns);
+# endif
+#endif
+
+#endif
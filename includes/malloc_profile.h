@@ -0,0 +1,40 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_profile.h                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:21:36 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 14:21:36 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_PROFILE_H
+#define MALLOC_PROFILE_H
+
+#include <stddef.h>
+
+// Sampling heap profiler (optional, build with `make PROFILE=1`).
+// Each thread samples one allocation about every `period` bytes, the gap being
+// drawn from an exponential distribution so every byte has the same chance of
+// being sampled. A sample keeps the backtrace of the allocation in a fixed-size
+// table mapped outside the managed heap; the block gets BLOCK_F_SAMPLED so
+// free() only touches the table for sampled blocks.
+#define MALLOC_PROFILE_PERIOD (512UL * 1024) // default mean sampling gap (bytes)
+#define MALLOC_PROFILE_SLOTS 8192			  // live samples kept (power of two)
+#define MALLOC_PROFILE_DEPTH 32				  // frames per backtrace
+
+// Write live samples as a legacy pprof heap profile (`heap_v2/<period>`)
+// followed by /proc/self/maps. Returns 0 on success, -1 on error or when the
+// profiler is not compiled in.
+int malloc_profile_dump(const char *path);
+// Change the mean sampling gap for subsequent samples; 0 stops sampling.
+void malloc_profile_set_period(size_t bytes);
+
+#ifdef MALLOC_PROFILE
+void malloc_profile_account(void *ptr, size_t size);
+void malloc_profile_forget(void *ptr);
+#endif
+
+#endif
@@ -6,7 +6,7 @@
 /*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2025/09/24 15:27:47 by tamigore          #+#    #+#             */
-/*   Updated: 2025/09/24 16:55:34 by tamigore         ###   ########.fr       */
+/*   Updated: 2026/10/20 11:25:10 by tamigore         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
@@ -14,9 +14,34 @@
 #define MALLOC_PTHREAD_H
 
 #include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // Thread-safety primitives for the allocator
 void malloc_lock(void);
 void malloc_unlock(void);
+// Per-CPU magazine depot (PERCPU=1 builds), instrumented like the global mutex.
+void malloc_depot_lock(void);
+void malloc_depot_unlock(void);
+
+// Lock instrumentation (counters are only updated when built with `make LOCKSTAT=1`).
+// Times are in malloc_cycles() ticks; histogram bucket k counts values in [2^k, 2^(k+1)).
+#define MALLOC_LOCK_HIST_BUCKETS 40
+
+typedef struct s_malloc_lock_stats
+{
+	const char *name;
+	uint64_t acquisitions; // outermost acquisitions (recursive re-entry not counted)
+	uint64_t contended;	   // acquisitions that had to wait for another owner
+	uint64_t wait_cycles;  // total time spent waiting (contended acquisitions)
+	uint64_t hold_cycles;  // total time between outermost lock and unlock
+	uint64_t wait_hist[MALLOC_LOCK_HIST_BUCKETS];
+	uint64_t hold_hist[MALLOC_LOCK_HIST_BUCKETS];
+} t_malloc_lock_stats;
+
+// Copy up to `max` lock records into `out`; returns the number of instrumented
+// locks: "global", then "depot" in PERCPU=1 builds.
+size_t malloc_lock_stats(t_malloc_lock_stats *out, size_t max);
+void malloc_lock_stats_reset(void);
 
 #endif
\ No newline at end of file
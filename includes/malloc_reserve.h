@@ -0,0 +1,67 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_reserve.h                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 21:07:14 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 14:20:06 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_RESERVE_H
+#define MALLOC_RESERVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// TINY/SMALL zones are carved in address order out of one PROT_NONE,
+// MAP_NORESERVE reservation made by the first zone, and committed with
+// mprotect. Zones are never returned, so the committed part only grows. When
+// the reservation cannot be made (address-space limits) or is full, zones fall
+// back to one mmap each. LARGE blocks are always mapped on their own.
+#ifndef MALLOC_RESERVE_SIZE
+# if UINTPTR_MAX > 0xffffffffUL
+#  define MALLOC_RESERVE_SIZE (64UL << 30)
+# else
+#  define MALLOC_RESERVE_SIZE (1UL << 30)
+# endif
+#endif
+#define MALLOC_RESERVE_MIN (256UL << 20) // smallest reservation tried before giving up
+
+// Transparent huge pages (make HUGEPAGE=1): the reservation and every mapping
+// of a huge-page multiple are 2 MiB aligned and advised MADV_HUGEPAGE (mappings
+// try MAP_HUGETLB first), and zone_allocation_size / the LARGE path round to
+// huge pages; the medium LARGE chunks (malloc_large.h) stay on regular pages.
+// Without kernel support the memory simply stays on small pages.
+#define MALLOC_HUGE_PAGE (2UL << 20)
+
+typedef struct s_reserve
+{
+	char *base; // start of the reservation (NULL before the first zone)
+	char *top;	// end of the committed part: zones lie in [base, top)
+	char *end;	// end of the reservation
+} t_reserve;
+
+extern t_reserve g_reserve;
+
+// Commit `bytes` (a page multiple) at the top of the reservation (allocator
+// mutex held). NULL when there is no reservation or it is full.
+void *malloc_reserve_commit(size_t bytes);
+
+// Read/write anonymous mapping of `bytes` for a fallback zone or a LARGE
+// block (huge-page backed when enabled and `bytes` is a huge-page multiple).
+// NULL on failure.
+void *malloc_map(size_t bytes);
+// Same on regular pages whatever the size: medium LARGE chunks, whose runs are
+// smaller than a huge page.
+void *malloc_map_small(size_t bytes);
+
+// Whether `p` lies in a committed TINY/SMALL zone of the reservation.
+static inline int malloc_reserve_owns(const void *p)
+{
+	return (const char *)p >= g_reserve.base && (const char *)p < g_reserve.top;
+}
+
+#endif
@@ -0,0 +1,66 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_show.h                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 15:02:11 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 15:02:11 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_SHOW_H
+#define MALLOC_SHOW_H
+
+#include <stdint.h>
+
+// Machine-readable heap dump. Zones come in ascending address order per type
+// (TINY, SMALL, LARGE) and each zone's blocks in address order, as in
+// show_alloc_mem().
+typedef enum e_show_format
+{
+	SHOW_FORMAT_JSON = 0,	// one JSON document (addresses as "0x..." strings)
+	SHOW_FORMAT_BINARY = 1, // t_show_bin_* records below, native byte order
+} t_show_format;
+
+// Binary layout: one header, then for each zone its record followed by its
+// `block_count` block records. `magic` read as a uint32_t gives the byte order.
+#define SHOW_BIN_MAGIC 0x484d5446U // bytes "FTMH" on little-endian hosts
+#define SHOW_BIN_VERSION 1
+
+#define SHOW_BLOCK_FREE 0x01   // block is free (in a bin)
+#define SHOW_BLOCK_CACHED 0x02 // parked in a per-CPU cache (counted as used)
+
+typedef struct s_show_bin_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t zone_count;
+	uint64_t block_count;
+} t_show_bin_header;
+
+typedef struct s_show_bin_zone
+{
+	uint64_t address;
+	uint64_t capacity; // data bytes
+	uint64_t used;	   // payload bytes handed out
+	uint32_t type;	   // t_zone_type
+	uint32_t block_count;
+} t_show_bin_zone;
+
+typedef struct s_show_bin_block
+{
+	uint64_t address;	// payload address
+	uint64_t size;		// aligned payload size
+	uint64_t requested; // size asked by the caller (0 for free blocks)
+	uint32_t flags;		// SHOW_BLOCK_*
+	uint32_t reserved;
+} t_show_bin_block;
+
+// Write every zone and block to `fd` in `format`. The allocator lock is only
+// held while the heap is copied. Returns 0, or -1 on a bad format, an mmap
+// failure or a write error.
+int show_alloc_mem_ex(int fd, t_show_format format);
+
+#endif
@@ -0,0 +1,50 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_sizemap.h                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 20:21:05 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 20:21:05 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_SIZEMAP_H
+#define MALLOC_SIZEMAP_H
+
+#include "malloc_class.h"
+#include "malloc_class_gen.h" // objects/, written by tools/gen_classes.c
+
+// Library-internal: the class layout baked in at build time for
+// MALLOC_GEN_PAGE_SIZE (make PAGE_SIZE=...). The public headers keep the
+// malloc_tiny_max() / malloc_class_*() functions.
+
+#undef TINY_MAX
+#undef SMALL_MAX
+#define TINY_MAX MALLOC_GEN_TINY_MAX
+#define SMALL_MAX MALLOC_GEN_SMALL_MAX
+
+extern const uint8_t g_malloc_size_class[] __attribute__((visibility("hidden")));
+extern const uint32_t g_malloc_class_bytes[MALLOC_CLASS_MAX] __attribute__((visibility("hidden")));
+
+// Class of a request of 0 < size <= SMALL_MAX.
+static inline size_t malloc_class_lookup(size_t size)
+{
+	return g_malloc_size_class[(size + MALLOC_ALIGN - 1) / MALLOC_ALIGN];
+}
+
+// Largest class a free block of size <= SMALL_MAX bytes (a multiple of
+// MALLOC_ALIGN) can serve.
+static inline size_t malloc_class_lookup_floor(size_t size)
+{
+	size_t idx = g_malloc_size_class[size / MALLOC_ALIGN];
+	return g_malloc_class_bytes[idx] > size && idx ? idx - 1 : idx;
+}
+
+static inline size_t malloc_class_bytes(size_t idx)
+{
+	return g_malloc_class_bytes[idx];
+}
+
+#endif
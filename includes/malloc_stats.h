@@ -0,0 +1,85 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_stats.h                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 13:05:48 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 23:51:08 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_STATS_H
+#define MALLOC_STATS_H
+
+#include "malloc_class.h"
+
+// Allocator statistics. Event counters are only maintained in `make STATS=1`
+// builds; the memory figures (zones, mapped, resident, dirty) are computed on
+// every read from the zone lists.
+//
+// Counters live in the arena (updated under the allocator mutex it already
+// holds) and, for the per-CPU fast path, in each CPU slab; a read aggregates
+// them. Size classes are the allocator's classes (malloc_class.h); LARGE
+// blocks are folded into the last entry.
+#define MALLOC_STATS_CLASSES (MALLOC_CLASS_MAX + 1)
+
+typedef enum e_malloc_alloc_path
+{
+	MALLOC_PATH_BIN = 0,	// reused a free block from the bins or quick lists
+	MALLOC_PATH_APPEND = 1, // carved from the tail of an existing zone
+	MALLOC_PATH_ZONE = 2,	// needed a new zone (always the case for LARGE)
+} t_malloc_alloc_path;
+
+typedef struct s_malloc_class_stats
+{
+	size_t size;		   // largest aligned size in this class (0 = unbounded)
+	uint64_t allocs;	   // blocks handed out
+	uint64_t frees;		   // blocks returned
+	uint64_t alloc_bytes;  // aligned bytes handed out
+	uint64_t free_bytes;   // aligned bytes returned
+	uint64_t live_objects; // allocs - frees (filled on read)
+	uint64_t live_bytes;   // alloc_bytes - free_bytes (filled on read)
+	uint64_t bin_hits;	   // allocations served by MALLOC_PATH_BIN
+	uint64_t append_allocs; // ... by MALLOC_PATH_APPEND
+	uint64_t zone_allocs;  // ... by MALLOC_PATH_ZONE
+	uint64_t cache_hits;   // ... by the per-CPU cache (PERCPU builds)
+	uint64_t splits;	   // free remainders split off an allocation
+	uint64_t coalesces;	   // neighbour merges performed by free()
+} t_malloc_class_stats;
+
+typedef struct s_malloc_stats
+{
+	t_malloc_class_stats types[3];						// by t_zone_type
+	t_malloc_class_stats classes[MALLOC_STATS_CLASSES]; // by size class
+	size_t zones[3];									// zone count by t_zone_type
+	size_t mapped;										// bytes mapped for zones
+	size_t resident;									// resident bytes of those mappings
+	size_t dirty;										// resident bytes not backing live blocks
+} t_malloc_stats;
+
+// Fill `out` (aggregated snapshot). Returns 0, or -1 when out is NULL.
+int malloc_stats_get(t_malloc_stats *out);
+// Print a per-type / per-class summary on stdout.
+void malloc_stats(void);
+
+// Internal hooks, called with the allocator mutex held.
+#ifdef MALLOC_STATS
+void malloc_stats_count_alloc(const t_block *b, t_malloc_alloc_path path);
+void malloc_stats_count_free(const t_block *b);
+void malloc_stats_count_split(const t_block *b);
+void malloc_stats_count_coalesce(const t_block *b);
+size_t malloc_stats_class(size_t size);
+# define MALLOC_STATS_ALLOC(b, path) malloc_stats_count_alloc((b), (path))
+# define MALLOC_STATS_FREE(b) malloc_stats_count_free(b)
+# define MALLOC_STATS_SPLIT(b) malloc_stats_count_split(b)
+# define MALLOC_STATS_COALESCE(b) malloc_stats_count_coalesce(b)
+#else
+# define MALLOC_STATS_ALLOC(b, path) ((void)0)
+# define MALLOC_STATS_FREE(b) ((void)0)
+# define MALLOC_STATS_SPLIT(b) ((void)0)
+# define MALLOC_STATS_COALESCE(b) ((void)0)
+#endif
+
+#endif
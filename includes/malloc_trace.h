@@ -0,0 +1,79 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   malloc_trace.h                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:12:03 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 10:41:27 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MALLOC_TRACE_H
+#define MALLOC_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Allocation trace recorder (optional, build with `make TRACE=1`).
+// With FT_MALLOC_TRACE=<prefix> in the environment, every thread appends one
+// record per public malloc/free/realloc call to its own file
+// `<prefix>.<pid>.<tid>.trace`, written through a shared file mapping (no
+// write() per call, nothing lost if the process dies). Calls made by the
+// allocator itself (realloc's inner malloc/free) are not recorded. A forked
+// child keeps writing to its parent's files until it starts a new thread.
+//
+// File layout: a t_trace_header in the first MALLOC_TRACE_HEADER_SIZE bytes,
+// then `count` t_trace_record entries. While the thread runs the file may
+// extend past the last record (preallocated chunk); trust `count`. Thread exit
+// cuts it back to the last record and releases the mappings and the fd.
+#define MALLOC_TRACE_ENV "FT_MALLOC_TRACE"
+#define MALLOC_TRACE_MAGIC 0x52544d46U // bytes "FMTR" on little-endian hosts
+#define MALLOC_TRACE_VERSION 1
+#define MALLOC_TRACE_HEADER_SIZE 4096UL
+#define MALLOC_TRACE_CHUNK 65536UL // records mapped at a time
+
+typedef enum e_trace_op
+{
+	MALLOC_TRACE_MALLOC = 1,
+	MALLOC_TRACE_FREE = 2,
+	MALLOC_TRACE_REALLOC = 3,
+} t_trace_op;
+
+typedef struct s_trace_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size; // sizeof(t_trace_record)
+	uint32_t tid;
+	uint64_t count;		// records written so far
+	uint64_t t0_cycles; // malloc_cycles() when the file was opened ...
+	uint64_t t0_ns;		// ... and CLOCK_MONOTONIC at the same moment
+	uint64_t reserved[3];
+} t_trace_header;
+
+typedef struct s_trace_record
+{
+	uint64_t ts;	 // malloc_cycles(): after malloc/realloc return, before free releases
+	uint64_t ptr;	 // argument pointer (free, realloc); 0 for malloc
+	uint64_t result; // returned pointer (malloc, realloc); 0 for free
+	uint64_t size;	 // requested size (malloc, realloc)
+	uint32_t tid;
+	uint32_t op; // t_trace_op
+} t_trace_record;
+
+#ifdef MALLOC_TRACE
+void malloc_trace_event(t_trace_op op, void *ptr, size_t size, void *result);
+void malloc_trace_enter(void);
+void malloc_trace_leave(void);
+# define MALLOC_TRACE_EVENT(op, ptr, size, result) malloc_trace_event((op), (ptr), (size), (result))
+# define MALLOC_TRACE_ENTER() malloc_trace_enter()
+# define MALLOC_TRACE_LEAVE() malloc_trace_leave()
+#else
+# define MALLOC_TRACE_EVENT(op, ptr, size, result) ((void)0)
+# define MALLOC_TRACE_ENTER() ((void)0)
+# define MALLOC_TRACE_LEAVE() ((void)0)
+#endif
+
+#endif
@@ -16,7 +16,26 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stddef.h>
+
+// Buffered formatter: output accumulates in `data` and goes out in large
+// write() calls (when full and on print_buf_flush). `error` sticks once a
+// write fails.
+typedef struct s_print_buf
+{
+	int fd;
+	char *data;
+	size_t cap;
+	size_t len;
+	int error;
+} t_print_buf;
+
+void print_buf_init(t_print_buf *pb, int fd, char *data, size_t cap);
+void print_buf(t_print_buf *pb, const char *fmt, ...);
+void print_buf_write(t_print_buf *pb, const void *src, size_t n);
+void print_buf_flush(t_print_buf *pb);
 
 void print(const char *fmt, ...);
+void print_fd(int fd, const char *fmt, ...);
 
 #endif
\ No newline at end of file
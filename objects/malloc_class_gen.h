@@ -0,0 +1,52 @@
+// Generated by tools/gen_classes.c for 4096-byte pages: do not edit.
+#ifndef MALLOC_CLASS_GEN_H
+#define MALLOC_CLASS_GEN_H
+
+#define MALLOC_GEN_PAGE_SIZE 4096UL
+#define MALLOC_GEN_TINY_MAX 128UL
+#define MALLOC_GEN_SMALL_MAX 4096UL
+#define MALLOC_GEN_CLASSES 28 // classes up to SMALL_MAX
+
+// Size of each class (MALLOC_CLASS_MAX entries).
+#define MALLOC_GEN_CLASS_SIZES \
+	{16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512,\
+	 640, 768, 896, 1024, 1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192,\
+	 10240, 12288, 14336, 16384, 20480, 24576, 28672, 32768, 40960, 49152, 57344, 65536, 81920, 98304, 114688, 131072,\
+	 163840, 196608, 229376, 262144, 327680, 393216, 458752, 524288, 655360, 786432, 917504, 1048576}
+
+// Class of a TINY/SMALL request, indexed by (size + 15) / 16.
+#define MALLOC_GEN_SIZE_CLASS \
+	{0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11,\
+	 11, 12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15,\
+	 15, 16, 16, 16, 16, 16, 16, 16, 16, 17, 17, 17, 17, 17, 17, 17,\
+	 17, 18, 18, 18, 18, 18, 18, 18, 18, 19, 19, 19, 19, 19, 19, 19,\
+	 19, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20,\
+	 20, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21,\
+	 21, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,\
+	 22, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23,\
+	 23, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,\
+	 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,\
+	 24, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25,\
+	 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25, 25,\
+	 25, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26,\
+	 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26, 26,\
+	 26, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27,\
+	 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27, 27,\
+	 27}
+
+// Class of a request of 1 << k bytes, for 1 << k up to SMALL_MAX.
+#define MALLOC_GEN_CLASS_POW2_0 0
+#define MALLOC_GEN_CLASS_POW2_1 0
+#define MALLOC_GEN_CLASS_POW2_2 0
+#define MALLOC_GEN_CLASS_POW2_3 0
+#define MALLOC_GEN_CLASS_POW2_4 0
+#define MALLOC_GEN_CLASS_POW2_5 1
+#define MALLOC_GEN_CLASS_POW2_6 3
+#define MALLOC_GEN_CLASS_POW2_7 7
+#define MALLOC_GEN_CLASS_POW2_8 11
+#define MALLOC_GEN_CLASS_POW2_9 15
+#define MALLOC_GEN_CLASS_POW2_10 19
+#define MALLOC_GEN_CLASS_POW2_11 23
+#define MALLOC_GEN_CLASS_POW2_12 27
+
+#endif
@@ -6,11 +6,13 @@
 /*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2025/09/19 14:10:19 by tamigore          #+#    #+#             */
-/*   Updated: 2025/09/28 15:05:38 by tamigore         ###   ########.fr       */
+/*   Updated: 2026/10/20 10:52:18 by tamigore         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
 #include "malloc_bin.h"
+#include "malloc_reserve.h"
+#include "malloc_sizemap.h"
 #include <sys/mman.h>
 #ifndef MAP_ANONYMOUS
 # ifdef MAP_ANON
@@ -20,18 +22,153 @@
 #include <unistd.h>
 #include <stdlib.h>
 
-static inline t_block ***bins_array_ref(void) { return g_zones ? &g_zones->bins : NULL; }
-static inline size_t *bins_count_ref(void) { return g_zones ? &g_zones->bin_count : NULL; }
+// Bin heads for the whole heap. They used to hang off the current g_zones head,
+// which silently swapped in a stale (or empty) array whenever a zone was pushed
+// to or unlinked from the head of the list.
+// One bin per size class and zone type (TINY bins first, then SMALL): bin i
+// holds free blocks of at least malloc_class_size(i) bytes and less than the
+// next class, the last bin everything larger. Any block of bin i therefore
+// fits a request of class <= i, and a TINY request never walks SMALL blocks.
+// Blocks of the last class and above (coalesced runs of any length) do not
+// go to a bin: they sit in one best-fit tree per zone type instead.
+static struct s_bin_state
+{
+	t_block **heads;	   // dynamic array of bin heads (mmap'd)
+	size_t count;		   // bins per zone type
+	uint64_t mask[2];	   // non-empty bins of each type: a miss costs no list walk
+	t_block *trees[2];	   // TINY / SMALL tree roots
+} g_bins = {NULL, 0, {0, 0}, {NULL, NULL}};
+
+_Static_assert(MALLOC_CLASS_MAX <= 64, "bin mask holds one bit per class");
+
+// ---------------- best-fit tree ----------------
+// A treap ordered by (size, address), its links kept in the free payload:
+// every block of the tree is at least malloc_class_size(count - 1) bytes. The
+// heap priority is a hash of the address, so the shape is random but
+// reproducible and no balance state is stored. A lookup returns the smallest
+// block that fits, the lowest-addressed one among equal sizes.
+typedef struct s_bin_node
+{
+	t_block *left;
+	t_block *right;
+} t_bin_node;
+
+static inline t_bin_node *tree_node(const t_block *b)
+{
+	return (t_bin_node *)(uintptr_t)(b + 1);
+}
+
+static inline uint64_t tree_priority(const t_block *b)
+{
+	uint64_t h = (uint64_t)(uintptr_t)b * 0x9E3779B97F4A7C15ULL;
+	return h ^ (h >> 29);
+}
+
+static inline int tree_less(const t_block *a, const t_block *b)
+{
+	return a->size < b->size || (a->size == b->size && a < b);
+}
+
+static inline int tree_member(const t_block *b)
+{
+	return b->size >= malloc_class_bytes(g_bins.count - 1);
+}
+
+// Split `t` into the blocks ordered before `key` and the others.
+static void tree_split(t_block *t, const t_block *key, t_block **lo, t_block **hi)
+{
+	if (!t)
+	{
+		*lo = *hi = NULL;
+		return;
+	}
+	if (tree_less(t, key))
+	{
+		*lo = t;
+		tree_split(tree_node(t)->right, key, &tree_node(t)->right, hi);
+	}
+	else
+	{
+		*hi = t;
+		tree_split(tree_node(t)->left, key, lo, &tree_node(t)->left);
+	}
+}
+
+// Join two treaps, every key of `lo` below every key of `hi`.
+static t_block *tree_merge(t_block *lo, t_block *hi)
+{
+	if (!lo || !hi)
+		return lo ? lo : hi;
+	if (tree_priority(lo) > tree_priority(hi))
+	{
+		tree_node(lo)->right = tree_merge(tree_node(lo)->right, hi);
+		return lo;
+	}
+	tree_node(hi)->left = tree_merge(lo, tree_node(hi)->left);
+	return hi;
+}
+
+static t_block *tree_insert(t_block *t, t_block *b)
+{
+	if (!t || tree_priority(b) > tree_priority(t))
+	{
+		tree_split(t, b, &tree_node(b)->left, &tree_node(b)->right);
+		return b;
+	}
+	if (tree_less(b, t))
+		tree_node(t)->left = tree_insert(tree_node(t)->left, b);
+	else
+		tree_node(t)->right = tree_insert(tree_node(t)->right, b);
+	return t;
+}
+
+// Unchanged tree when `b` is not in it.
+static t_block *tree_remove(t_block *t, t_block *b)
+{
+	if (!t)
+		return NULL;
+	if (t == b)
+		return tree_merge(tree_node(b)->left, tree_node(b)->right);
+	if (tree_less(b, t))
+		tree_node(t)->left = tree_remove(tree_node(t)->left, b);
+	else
+		tree_node(t)->right = tree_remove(tree_node(t)->right, b);
+	return t;
+}
+
+static t_block *tree_best_fit(t_block *t, size_t size)
+{
+	t_block *best = NULL;
+	while (t)
+	{
+		if (t->size >= size)
+		{
+			best = t;
+			t = tree_node(t)->left;
+		}
+		else
+			t = tree_node(t)->right;
+	}
+	return best;
+}
+
+static void tree_walk(const t_block *t, void (*fn)(const t_block *, void *), void *arg)
+{
+	for (; t; t = tree_node(t)->right)
+	{
+		tree_walk(tree_node(t)->left, fn, arg);
+		fn(t, arg);
+	}
+}
+
+// ---------------- bins ----------------
 
 static void bins_init(void)
 {
-	if (!g_zones)
-		return; // need at least one zone before we can host bins metadata
-	if (g_zones->bins)
+	if (g_bins.heads)
 		return;
-	size_t small_max = SMALL_MAX; // runtime value
-	size_t count = (small_max / MALLOC_ALIGN) + 1;
-	size_t bytes = count * sizeof(t_block *);
+	size_t count = malloc_class_count();
+	size_t bytes = 2 * count * sizeof(t_block *);
 	t_block **arr = NULL;
 #ifdef MAP_ANONYMOUS
 	arr = (t_block **)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
@@ -43,20 +180,21 @@ static void bins_init(void)
 	#endif
 #endif
 	if (arr == MAP_FAILED)
-	{
-		g_zones->bins = NULL;
-		g_zones->bin_count = 0; // disable bins on failure
-		return;
-	}
+		return; // bins stay disabled; allocation falls back to zone appends
 	// mmap zero-initialized; store metadata.
-	g_zones->bins = arr;
-	g_zones->bin_count = count;
+	g_bins.heads = arr;
+	g_bins.count = count;
 }
 
+// A header in the reservation can only belong to the reserved zone its
+// back-pointer names; only headers outside it fall back to the zone walk.
 static inline int block_in_any_zone(t_block *b)
 {
 	if (!b)
 		return 0;
+	if (malloc_reserve_owns(b))
+		return malloc_reserve_owns(b->zone) && (char *)b >= (char *)b->zone + b->zone->data_offset &&
+			   (char *)b + sizeof(t_block) <= (char *)b->zone + b->zone->data_offset + b->zone->capacity;
 	if (b->zone)
 	{
 		char *zs = (char *)b->zone + b->zone->data_offset;
@@ -66,6 +204,8 @@ static inline int block_in_any_zone(t_block *b)
 	}
 	for (t_zone *z = g_zones; z; z = z->next)
 	{
+		if (z->type == ZONE_LARGE || malloc_reserve_owns(z))
+			continue; // never binned (header out of line) / checked above
 		char *zs = (char *)z + z->data_offset;
 		char *ze = zs + z->capacity;
 		if ((char *)b >= zs && (char *)b + (ptrdiff_t)sizeof(t_block) <= ze)
@@ -77,22 +217,22 @@ static inline int block_in_any_zone(t_block *b)
 	return 0;
 }
 
-static inline size_t clamp_index(size_t idx)
+// Head slot of the bin a free block belongs to (b->zone is set).
+static inline t_block **bin_slot(const t_block *b)
 {
-	if (!g_zones || !g_zones->bins || g_zones->bin_count == 0)
-		return 0;
-	if (idx >= g_zones->bin_count)
-		return g_zones->bin_count - 1;
-	return idx;
+	size_t idx = b->size <= SMALL_MAX ? malloc_class_lookup_floor(b->size) : g_bins.count - 1;
+	return &g_bins.heads[(size_t)b->zone->type * g_bins.count + idx];
 }
 
-static inline size_t bin_index(size_t size)
+// Refresh the mask bit of a bin after its head changed.
+static inline void bin_mark(t_block **head)
 {
-	size_t aligned = ALIGN_UP(size, MALLOC_ALIGN);
-	size_t idx = (aligned / MALLOC_ALIGN);
-	if (idx)
-		idx--; // size in [16] => idx 0
-	return clamp_index(idx);
+	size_t slot = (size_t)(head - g_bins.heads);
+	uint64_t bit = 1ULL << (slot % g_bins.count);
+	if (*head)
+		g_bins.mask[slot / g_bins.count] |= bit;
+	else
+		g_bins.mask[slot / g_bins.count] &= ~bit;
 }
 
 void malloc_bin_insert(t_block *b)
@@ -102,27 +242,43 @@ void malloc_bin_insert(t_block *b)
 	if (!block_in_any_zone(b))
 		return;
 	bins_init();
-	if (!g_zones || !g_zones->bins)
+	if (!g_bins.heads || b->zone->type == ZONE_LARGE)
 		return;
-	size_t idx = bin_index(b->size);
+	if (tree_member(b))
+	{
+		t_block **root = &g_bins.trees[b->zone->type];
+		*root = tree_insert(*root, b);
+		return;
+	}
+	t_block **head = bin_slot(b);
 	b->bin_prev = NULL;
-	b->bin_next = g_zones->bins[idx];
-	if (g_zones->bins[idx])
-		g_zones->bins[idx]->bin_prev = b;
-	g_zones->bins[idx] = b;
+	b->bin_next = *head;
+	if (*head)
+		(*head)->bin_prev = b;
+	*head = b;
+	bin_mark(head);
 }
 
 static void bin_detach(t_block *b)
 {
-	if (!b || !g_zones || !g_zones->bins)
+	if (!b || !g_bins.heads)
 		return;
+	if (b->zone && b->zone->type != ZONE_LARGE && tree_member(b))
+	{
+		t_block **root = &g_bins.trees[b->zone->type];
+		*root = tree_remove(*root, b);
+		return;
+	}
 	if (b->bin_prev)
 		b->bin_prev->bin_next = b->bin_next;
-	else
+	else if (b->zone && b->zone->type != ZONE_LARGE)
 	{
-		size_t idx = bin_index(b->size);
-		if (g_zones->bins[idx] == b)
-			g_zones->bins[idx] = b->bin_next;
+		t_block **head = bin_slot(b);
+		if (*head == b)
+		{
+			*head = b->bin_next;
+			bin_mark(head);
+		}
 	}
 	if (b->bin_next)
 		b->bin_next->bin_prev = b->bin_prev;
@@ -132,12 +288,16 @@ static void bin_detach(t_block *b)
 t_block *malloc_bin_take(size_t size, t_zone_type want_type)
 {
 	bins_init();
-	if (!g_zones || !g_zones->bins)
+	if (!g_bins.heads || want_type == ZONE_LARGE)
 		return NULL;
-	size_t idx = bin_index(size);
-	for (size_t i = idx; i < g_zones->bin_count; ++i)
+	size_t idx = malloc_class_lookup(size);
+	t_block **heads = &g_bins.heads[(size_t)want_type * g_bins.count];
+	uint64_t nonempty = g_bins.mask[want_type] >> idx << idx;
+	nonempty &= ~(1ULL << (g_bins.count - 1)); // the last bin is the tree
+	for (; nonempty; nonempty &= nonempty - 1)
 	{
-		t_block *b = g_zones->bins[i];
+		size_t i = (size_t)__builtin_ctzll(nonempty);
+		t_block *b = heads[i];
 		while (b)
 		{
 			t_block *next = b->bin_next;
@@ -145,16 +305,17 @@ t_block *malloc_bin_take(size_t size, t_zone_type want_type)
 			{
 				if (b->bin_prev)
 					b->bin_prev->bin_next = b->bin_next;
-				else if (g_zones->bins[i] == b)
-					g_zones->bins[i] = b->bin_next;
+				else if (heads[i] == b)
+					heads[i] = b->bin_next;
 				if (b->bin_next)
 					b->bin_next->bin_prev = b->bin_prev;
 				b->bin_next = b->bin_prev = NULL;
+				bin_mark(&heads[i]);
 				b = next;
 				continue;
 			}
-			// Enforce zone type match; skip mismatched bins
-			if (b->free && b->size >= size && b->zone && b->zone->type == want_type)
+			// Bins from the request's class up only hold blocks that fit: safety net
+			if (b->free && b->size >= size && b->zone->type == want_type)
 			{
 				bin_detach(b);
 				b->free = 0;
@@ -163,7 +324,13 @@ t_block *malloc_bin_take(size_t size, t_zone_type want_type)
 			b = next;
 		}
 	}
-	return NULL;
+	t_block **root = &g_bins.trees[want_type];
+	t_block *b = tree_best_fit(*root, size);
+	if (!b)
+		return NULL;
+	*root = tree_remove(*root, b);
+	b->free = 0;
+	return b;
 }
 
 void malloc_bin_remove(t_block *b)
@@ -175,7 +342,25 @@ void malloc_bin_remove(t_block *b)
 	if (b->free)
 	{
 		bins_init();
-		if (g_zones && g_zones->bins)
+		if (g_bins.heads)
 			bin_detach(b);
 	}
 }
+
+size_t malloc_bin_count(void)
+{
+	return g_bins.heads ? g_bins.count : 0;
+}
+
+const t_block *malloc_bin_head(t_zone_type type, size_t idx)
+{
+	if (!g_bins.heads || type == ZONE_LARGE || idx >= g_bins.count)
+		return NULL;
+	return g_bins.heads[(size_t)type * g_bins.count + idx];
+}
+
+void malloc_bin_tree_walk(t_zone_type type, void (*fn)(const t_block *, void *), void *arg)
+{
+	if (g_bins.heads && type != ZONE_LARGE)
+		tree_walk(g_bins.trees[type], fn, arg);
+}
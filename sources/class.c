@@ -0,0 +1,50 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   class.c                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 19:48:26 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 20:21:05 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_malloc.h"
+#include "malloc_sizemap.h"
+
+const uint8_t g_malloc_size_class[] = MALLOC_GEN_SIZE_CLASS;
+const uint32_t g_malloc_class_bytes[MALLOC_CLASS_MAX] = MALLOC_GEN_CLASS_SIZES;
+
+// TINY/SMALL requests read the generated table; the arithmetic below only
+// serves larger sizes (statistics of SMALL blocks grown by coalescing).
+// Above the linear part, size-1 has its top bit k (the octave) and the next
+// MALLOC_CLASS_STEPS_SHIFT bits select one of the four classes of the octave.
+size_t malloc_class_index(size_t size)
+{
+	if (size <= SMALL_MAX)
+		return malloc_class_lookup(size);
+	size_t s = size - 1;
+	unsigned k = (unsigned)(sizeof(unsigned long) * 8 - 1) - (unsigned)__builtin_clzl((unsigned long)s);
+	size_t sub = (s - (1UL << k)) >> (k - MALLOC_CLASS_STEPS_SHIFT);
+	size_t idx = MALLOC_CLASS_LINEAR + (k - MALLOC_CLASS_LINEAR_SHIFT) * MALLOC_CLASS_STEPS + sub;
+	return idx < MALLOC_CLASS_MAX ? idx : MALLOC_CLASS_MAX - 1;
+}
+
+size_t malloc_class_size(size_t idx)
+{
+	return malloc_class_bytes(idx < MALLOC_CLASS_MAX ? idx : MALLOC_CLASS_MAX - 1);
+}
+
+size_t malloc_class_floor(size_t size)
+{
+	size_t idx = malloc_class_index(size);
+	if (malloc_class_size(idx) > size && idx)
+		idx--;
+	return idx;
+}
+
+size_t malloc_class_count(void)
+{
+	return MALLOC_GEN_CLASSES;
+}
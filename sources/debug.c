@@ -6,7 +6,7 @@
 /*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2025/09/19 14:10:16 by tamigore          #+#    #+#             */
-/*   Updated: 2025/09/26 11:26:05 by tamigore         ###   ########.fr       */
+/*   Updated: 2026/10/20 10:52:18 by tamigore         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
@@ -16,13 +16,18 @@ static t_block *ptr_to_block_internal(void *ptr)
 {
 	if (!ptr)
 		return NULL;
-	return (t_block *)((char *)ptr - sizeof(t_block));
+	return ptr_to_block(ptr);
 }
 
 static int header_in_our_zones(t_block *b)
 {
 	if (!b)
 		return 0;
+	if (b->zone && b->zone->type == ZONE_LARGE && b == &((t_large *)b->zone)->block)
+		return malloc_large_find(block_payload(b)) == b;
+	if (malloc_reserve_owns(b)) // reserved zones: the back-pointer is the only candidate
+		return malloc_reserve_owns(b->zone) && (char *)b >= (char *)b->zone + b->zone->data_offset &&
+			   (char *)b + sizeof(t_block) <= (char *)b->zone + b->zone->data_offset + b->zone->capacity;
 	if (b->zone)
 	{
 		char *zs = (char *)b->zone + b->zone->data_offset;
@@ -32,6 +37,8 @@ static int header_in_our_zones(t_block *b)
 	}
 	for (t_zone *z = g_zones; z; z = z->next)
 	{
+		if (z->type == ZONE_LARGE || malloc_reserve_owns(z))
+			continue; // found through the page map / the reservation above
 		char *zs = (char *)z + z->data_offset;
 		char *ze = zs + z->capacity;
 		if ((char *)b >= zs && (char *)b + (ptrdiff_t)sizeof(t_block) <= ze)
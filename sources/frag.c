@@ -0,0 +1,139 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   frag.c                                             :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 15:40:27 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 10:04:12 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_malloc.h"
+#include "malloc_frag.h"
+#include "print.h"
+
+// Live/free totals and tail slack from the zone block lists.
+static void frag_walk_zones(t_malloc_frag *out)
+{
+	for (t_zone *z = g_zones; z; z = z->next)
+	{
+		t_malloc_frag_type *t = &out->types[z->type];
+		t->zones++;
+		t->capacity += z->capacity;
+		char *tail_end = zone_base(z) + z->data_offset;
+		for (t_block *b = z->blocks; b; b = b->next)
+		{
+			if (block_is_free(b))
+			{
+				t->free_blocks++;
+				t->free_bytes += b->size;
+				if (b->size > t->largest_free)
+					t->largest_free = b->size;
+			}
+			else
+			{
+				t->live_blocks++;
+				t->live_bytes += b->size;
+				t->requested_bytes += b->requested <= b->size ? b->requested : b->size;
+			}
+			tail_end = (char *)block_payload(b) + b->size;
+		}
+		char *data_end = zone_base(z) + z->data_offset + z->capacity;
+		if (data_end > tail_end)
+			t->tail_slack += (size_t)(data_end - tail_end);
+	}
+}
+
+// Blocks of the best-fit tree count in the last bin.
+static void frag_count_tree(const t_block *b, void *arg)
+{
+	t_malloc_frag_type *t = arg;
+	size_t last = malloc_bin_count() - 1;
+	size_t slot = last < MALLOC_FRAG_BINS ? last : MALLOC_FRAG_BINS - 1;
+	t->bin_blocks[slot]++;
+	t->bin_bytes[slot] += b->size;
+}
+
+// Free block size histogram, bin by bin; parked quick-list blocks count in
+// the bin of their class.
+static void frag_walk_bins(t_malloc_frag *out)
+{
+	size_t count = malloc_bin_count();
+	for (int k = ZONE_TINY; k <= ZONE_SMALL; ++k)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			size_t slot = i < MALLOC_FRAG_BINS ? i : MALLOC_FRAG_BINS - 1;
+			for (const t_block *b = malloc_bin_head((t_zone_type)k, i); b; b = b->bin_next)
+			{
+				out->types[k].bin_blocks[slot]++;
+				out->types[k].bin_bytes[slot] += b->size;
+			}
+			for (const t_block *b = malloc_quick_head((t_zone_type)k, i); b; b = b->bin_next)
+			{
+				out->types[k].bin_blocks[slot]++;
+				out->types[k].bin_bytes[slot] += b->size;
+			}
+		}
+		malloc_bin_tree_walk((t_zone_type)k, frag_count_tree, &out->types[k]);
+	}
+}
+
+int malloc_frag_get(t_malloc_frag *out)
+{
+	if (!out)
+		return -1;
+	*out = (t_malloc_frag){0};
+	malloc_lock();
+	frag_walk_zones(out);
+	frag_walk_bins(out);
+	malloc_unlock();
+	for (int k = 0; k < 3; ++k)
+	{
+		t_malloc_frag_type *t = &out->types[k];
+		t->internal = t->live_bytes - t->requested_bytes;
+		if (t->free_bytes)
+			t->external = 1.0 - (double)t->largest_free / (double)t->free_bytes;
+		if (t->live_bytes)
+			t->internal_ratio = (double)t->internal / (double)t->live_bytes;
+		if (t->capacity)
+			t->tail_share = (double)t->tail_slack / (double)t->capacity;
+		for (size_t i = 0; i < MALLOC_FRAG_BINS && i < MALLOC_CLASS_MAX; ++i)
+			t->bin_size[i] = malloc_class_size(i);
+	}
+	return 0;
+}
+
+// Ratio as a percentage with two decimals (print() has no %f).
+static void print_ratio(const char *label, double r)
+{
+	size_t bp = (size_t)(r * 10000.0 + 0.5);
+	print(" %s=%u.%s%u%%", label, bp / 100, (bp % 100) < 10 ? "0" : "", bp % 100);
+}
+
+void malloc_frag_report(void)
+{
+	// Large struct: keep it off the (possibly small) caller stack.
+	t_malloc_frag *fr = mmap(NULL, sizeof(*fr), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (fr == MAP_FAILED)
+		return;
+	malloc_frag_get(fr);
+	for (int k = 0; k < 3; ++k)
+	{
+		const t_malloc_frag_type *t = &fr->types[k];
+		print("%s zones=%u capacity=%u live=%u/%u bytes free=%u/%u bytes largest_free=%u tail=%u internal=%u",
+			  zone_type_to_string((t_zone_type)k), t->zones, t->capacity, t->live_blocks, t->live_bytes,
+			  t->free_blocks, t->free_bytes, t->largest_free, t->tail_slack, t->internal);
+		print_ratio("external", t->external);
+		print_ratio("internal", t->internal_ratio);
+		print_ratio("tail", t->tail_share);
+		print("\n");
+		for (size_t i = 0; i < MALLOC_FRAG_BINS; ++i)
+			if (t->bin_blocks[i])
+				print("  bin %u : blocks=%u bytes=%u\n", t->bin_size[i], (size_t)t->bin_blocks[i],
+					  (size_t)t->bin_bytes[i]);
+	}
+	munmap(fr, sizeof(*fr));
+}
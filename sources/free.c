@@ -6,11 +6,15 @@
 /*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2025/09/17 11:21:03 by tamigore          #+#    #+#             */
-/*   Updated: 2025/09/28 15:06:22 by tamigore         ###   ########.fr       */
+/*   Updated: 2026/10/20 11:10:02 by tamigore         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
 #include "ft_malloc.h"
+#include "malloc_percpu.h"
+#include "malloc_stats.h"
+#include "malloc_profile.h"
+#include "malloc_sizemap.h"
 #include <stdlib.h>
 
 // Environment variable access removed for compliance; always disabled unless
@@ -40,38 +44,65 @@ static int zone_verify_chain(t_zone *z)
 	return 1;
 }
 
-static void zone_recompute_layout(t_zone *z)
+// Coalescing only removes blocks after the canonical one, so the zone tail
+// changes only when the merged block became the last one.
+static void zone_update_tail(t_zone *z, t_block *b)
 {
-	if (!z)
-		return;
-	t_block *last = NULL;
-	size_t safety = 0;
-	char *zone_start = (char *)z + z->data_offset;
-	char *zone_end = zone_start + z->capacity;
-	for (t_block *b = z->blocks; b; b = b->next)
-	{
-		if (++safety > 100000)
-			break;
-		if ((char *)b < zone_start || (char *)b >= zone_end)
-			break;
-		if (b->next && (char *)b->next <= (char *)b)
-			break;
-		last = b;
-	}
-	z->tail = last;
-	(void)zone_start;
-	(void)zone_end; /* span removed */
+	if (!b->next)
+		z->tail = b;
 	if (malloc_env_verify())
 		zone_verify_chain(z);
 }
 
 static int block_in_zone(t_zone *z, t_block *b)
 {
+	if (z->type == ZONE_LARGE)
+		return b == &((t_large *)z)->block; // header out of line
 	char *zs = (char *)z + z->data_offset;
 	char *ze = (char *)z + z->data_offset + z->capacity;
 	return ((char *)b >= zs && (char *)b < ze);
 }
 
+// Quick lists by zone type and size class, linked through bin_next.
+static struct s_quick_state
+{
+	t_block *heads[2][MALLOC_CLASS_MAX];
+	uint64_t mask[2]; // non-empty lists (MALLOC_CLASS_MAX <= 64, see bins.c)
+	size_t count;
+} g_quick;
+
+static void quick_push(t_block *b)
+{
+	size_t cls = malloc_class_lookup_floor(b->size);
+	t_block **head = &g_quick.heads[b->zone->type][cls];
+	b->flags |= BLOCK_F_QUICK;
+	b->bin_prev = NULL;
+	b->bin_next = *head;
+	*head = b;
+	g_quick.mask[b->zone->type] |= 1ULL << cls;
+	g_quick.count++;
+}
+
+// `size` is a class size; a block may be larger than its class (reused without
+// a split) and is returned whole, like a bin hit.
+t_block *malloc_quick_take(size_t size, t_zone_type type)
+{
+	if (!g_quick.count || type == ZONE_LARGE || size > MALLOC_QUICK_MAX_SIZE)
+		return NULL;
+	size_t cls = malloc_class_lookup(size);
+	t_block **head = &g_quick.heads[type][cls];
+	t_block *b = *head;
+	if (!b)
+		return NULL;
+	*head = b->bin_next;
+	if (!*head)
+		g_quick.mask[type] &= ~(1ULL << cls);
+	b->bin_next = NULL;
+	b->flags &= (unsigned char)~BLOCK_F_QUICK;
+	g_quick.count--;
+	return b;
+}
+
 static t_block *coalesce_block(t_block *b)
 {
 	// Merge with next while next is free
@@ -79,6 +110,7 @@ static t_block *coalesce_block(t_block *b)
 	{
 		t_block *n = b->next;
 		malloc_bin_remove(n);
+		MALLOC_STATS_COALESCE(b);
 		b->size += sizeof(t_block) + n->size;
 		b->next = n->next;
 		if (n->next)
@@ -89,6 +121,7 @@ static t_block *coalesce_block(t_block *b)
 	{
 		t_block *p = b->prev;
 		malloc_bin_remove(p); // remove previous from bin before enlarging
+		MALLOC_STATS_COALESCE(p);
 		p->size += sizeof(t_block) + b->size;
 		p->next = b->next;
 		if (b->next)
@@ -101,6 +134,7 @@ static t_block *coalesce_block(t_block *b)
 		{
 			t_block *n = b->next;
 			malloc_bin_remove(n);
+			MALLOC_STATS_COALESCE(b);
 			b->size += sizeof(t_block) + n->size;
 			b->next = n->next;
 			if (n->next)
@@ -110,22 +144,114 @@ static t_block *coalesce_block(t_block *b)
 	return b;
 }
 
+// Merge a freed TINY/SMALL block with its free neighbours and bin the result.
+static void release_block(t_zone *owner, t_block *b)
+{
+	b->free = 1;
+	// Coalesce adjacent free blocks FIRST, then insert final merged block in bins.
+	// Inserting before coalesce and then changing size corrupts bin lists
+	// because bin_detach computes index from current size.
+	// We need owner zone to maintain tail/span if end block merges.
+	b = coalesce_block(b);
+	// Ensure merged canonical block retains correct zone pointer
+	b->zone = owner;
+	// Keep the zone tail (also validates chain if enabled)
+	zone_update_tail(owner, b);
+	b->bin_next = b->bin_prev = NULL;
+	malloc_bin_insert(b);
+}
+
+const t_block *malloc_quick_head(t_zone_type type, size_t cls)
+{
+	if (type == ZONE_LARGE || cls >= MALLOC_CLASS_MAX)
+		return NULL;
+	return g_quick.heads[type][cls];
+}
+
+// Parked blocks are merged in free order, each with the neighbours released
+// before it; a neighbour still parked is not free and stays apart until its turn.
+size_t malloc_quick_flush(void)
+{
+	size_t released = g_quick.count;
+	if (!released)
+		return 0;
+	for (int t = ZONE_TINY; t <= ZONE_SMALL; ++t)
+	{
+		for (uint64_t m = g_quick.mask[t]; m; m &= m - 1)
+		{
+			t_block **head = &g_quick.heads[t][__builtin_ctzll(m)];
+			while (*head)
+			{
+				t_block *b = *head;
+				*head = b->bin_next;
+				b->flags &= (unsigned char)~BLOCK_F_QUICK;
+				release_block(b->zone, b);
+			}
+		}
+		g_quick.mask[t] = 0;
+	}
+	g_quick.count = 0;
+	return released;
+}
+
+// Return a checked, allocated block to its zone (allocator mutex held).
+static void give_back(t_zone *owner, t_block *b)
+{
+	if (owner->used >= b->size)
+		owner->used -= b->size;
+	if (owner->type == ZONE_LARGE)
+	{
+		b->free = 1;
+		malloc_large_free(b); // unlink and unmap the whole mapping
+		return;
+	}
+	if (b->size <= MALLOC_QUICK_MAX_SIZE)
+	{
+		quick_push(b);
+		if (g_quick.count > MALLOC_QUICK_LIMIT)
+			malloc_quick_flush();
+	}
+	else
+		release_block(owner, b);
+}
+
 void free(void *ptr)
 {
+	if (ptr)
+		MALLOC_TRACE_EVENT(MALLOC_TRACE_FREE, ptr, 0, NULL);
+#ifdef MALLOC_PERCPU
+	if (ptr && malloc_percpu_push(ptr))
+		return;
+#endif
 	malloc_lock();
 	if (!ptr)
 	{
 		malloc_unlock();
 		return;
 	}
+	if (malloc_large_stale(ptr))
+	{
+		malloc_unlock();
+		return;
+	} // double free guard (released medium run: its old bytes are no header)
 	t_block *b = ptr_to_block(ptr);
 	t_zone *owner = b->zone; // back-pointer
-	if (!owner || !block_in_zone(owner, b))
+	if (malloc_reserve_owns(b))
+	{
+		// Reserved zones hold TINY/SMALL blocks only, named by the back-pointer.
+		if (!malloc_reserve_owns(owner) || !block_in_zone(owner, b))
+		{
+			malloc_unlock();
+			return;
+		}
+	}
+	else if (!owner || !block_in_zone(owner, b))
 	{
-		// Fallback: attempt to locate via linear scan only if zone pointer missing
+		// Fallback: linear scan of the zones mapped outside the reservation
+		owner = NULL;
 		for (t_zone *z = g_zones; z; z = z->next)
 		{
-			if (block_in_zone(z, b))
+			if (!malloc_reserve_owns(z) && block_in_zone(z, b))
 			{
 				owner = z;
 				break;
@@ -138,39 +264,31 @@ void free(void *ptr)
 		}
 		b->zone = owner; // repair if possible
 	}
-	if (b->free)
+	if (b->free || (b->flags & BLOCK_F_QUICK))
 	{
 		malloc_unlock();
 		return;
 	} // double free guard
-	b->free = 1;
-	if (owner->used >= b->size)
-		owner->used -= b->size;
-	if (owner->type == ZONE_LARGE)
+#ifdef MALLOC_PROFILE
+	if (b->flags & BLOCK_F_SAMPLED)
+		malloc_profile_forget(ptr);
+#endif
+	MALLOC_STATS_FREE(b);
+	give_back(owner, b);
+	malloc_unlock();
+}
+
+#ifdef MALLOC_PERCPU
+// Blocks leave the cache uncounted: malloc_percpu_push() counted the free.
+void malloc_cache_release(void **objs, size_t n)
+{
+	malloc_lock();
+	for (size_t i = 0; i < n; ++i)
 	{
-		// Unlink owner from g_zones and unmap entire mapping
-		t_zone **pp = &g_zones;
-		while (*pp && *pp != owner)
-			pp = &(*pp)->next;
-		if (*pp)
-			*pp = owner->next;
-		// Total mapping size originally requested when creating this large zone:
-		// alloc = data_offset + capacity
-		size_t total = owner->data_offset + owner->capacity;
-		munmap(owner, total);
-		malloc_unlock();
-		return;
+		t_block *b = ptr_to_block(objs[i]);
+		b->flags &= (unsigned char)~BLOCK_F_CACHED;
+		give_back(b->zone, b);
 	}
-	// Coalesce adjacent free blocks FIRST, then insert final merged block in bins.
-	// Inserting before coalesce and then changing size corrupts bin lists
-	// because bin_detach computes index from current size.
-	// We need owner zone to maintain tail/span if end block merges.
-	b = coalesce_block(b);
-	// Ensure merged canonical block retains correct zone pointer
-	b->zone = owner;
-	// Recompute zone tail/span (also validates chain if enabled)
-	zone_recompute_layout(owner);
-	b->bin_next = b->bin_prev = NULL;
-	malloc_bin_insert(b);
 	malloc_unlock();
 }
+#endif
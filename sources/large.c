@@ -0,0 +1,337 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   large.c                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 21:58:40 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 14:20:06 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_malloc.h"
+#include "malloc_large.h"
+#include "malloc_reserve.h"
+
+#ifndef MAP_NORESERVE
+# define MAP_NORESERVE 0
+#endif
+
+// Page map: root[page >> LEAF_BITS][page & LEAF_MASK] -> record, over the
+// user address space (48 bits on 64-bit hosts). Both levels are NORESERVE
+// mappings, so only the touched pages of a leaf cost memory.
+#if UINTPTR_MAX > 0xffffffffUL
+# define LARGE_ADDR_BITS 48
+#else
+# define LARGE_ADDR_BITS 32
+#endif
+#define LARGE_PAGE_SHIFT 12 // log2(MALLOC_LARGE_GRAIN)
+#define LARGE_ROOT_BITS (LARGE_ADDR_BITS - LARGE_PAGE_SHIFT - MALLOC_LARGE_LEAF_BITS)
+#define LARGE_LEAF_MASK ((1UL << MALLOC_LARGE_LEAF_BITS) - 1)
+// Free run lists: one per page count up to MALLOC_MEDIUM_MAX, the last one for
+// longer runs (chunk remainders), with a bitmap of the non-empty lists.
+#define MEDIUM_LISTS (MALLOC_MEDIUM_MAX / MALLOC_LARGE_GRAIN + 2)
+#define MEDIUM_WORDS ((MEDIUM_LISTS + 63) / 64)
+// Page map entry of a chunk page that started or ended a run before a merge:
+// no run starts there any more, so a free() of it is a stale pointer.
+#define LARGE_RETIRED ((t_large *)1)
+
+static t_large **g_large_root[1UL << LARGE_ROOT_BITS];
+static t_large *g_large_free; // recycled records
+static t_large *g_runs[MEDIUM_LISTS];
+static uint64_t g_runs_mask[MEDIUM_WORDS];
+static size_t g_empty_chunks; // entirely free chunks kept (at most one)
+
+static void *map_noreserve(size_t bytes)
+{
+	void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return p == MAP_FAILED ? NULL : p;
+}
+
+// Leaf slot of `ptr`, created on demand when `create` is set.
+static t_large **large_slot(const void *ptr, int create)
+{
+	uintptr_t page = (uintptr_t)ptr >> LARGE_PAGE_SHIFT;
+	if (page >> (MALLOC_LARGE_LEAF_BITS + LARGE_ROOT_BITS))
+		return NULL; // above the mapped address range
+	t_large ***root = &g_large_root[page >> MALLOC_LARGE_LEAF_BITS];
+	t_large **leaf = __atomic_load_n(root, __ATOMIC_ACQUIRE);
+	if (!leaf && create)
+	{
+		leaf = map_noreserve((1UL << MALLOC_LARGE_LEAF_BITS) * sizeof(t_large *));
+		__atomic_store_n(root, leaf, __ATOMIC_RELEASE);
+	}
+	return leaf ? &leaf[page & LARGE_LEAF_MASK] : NULL;
+}
+
+static t_large *large_entry(const void *ptr)
+{
+	t_large **slot = large_slot(ptr, 0);
+	return slot ? __atomic_load_n(slot, __ATOMIC_ACQUIRE) : NULL;
+}
+
+static t_large *large_get(const void *ptr)
+{
+	t_large *r = large_entry(ptr);
+	return r == LARGE_RETIRED ? NULL : r;
+}
+
+static void large_set(const void *ptr, t_large *r)
+{
+	t_large **slot = large_slot(ptr, r != NULL);
+	if (slot)
+		__atomic_store_n(slot, r, __ATOMIC_RELEASE);
+}
+
+// Records come from whole pages carved once and then recycled.
+static t_large *large_record(void)
+{
+	if (!g_large_free)
+	{
+		size_t ps = malloc_pagesize();
+		t_large *page = map_noreserve(ps);
+		if (!page)
+			return NULL;
+		for (size_t i = 0; i < ps / sizeof(t_large); ++i)
+		{
+			page[i].run_next = g_large_free;
+			g_large_free = &page[i];
+		}
+	}
+	t_large *r = g_large_free;
+	g_large_free = r->run_next;
+	*r = (t_large){0};
+	r->zone.type = ZONE_LARGE;
+	r->block.zone = &r->zone;
+	return r;
+}
+
+static void large_recycle(t_large *r)
+{
+	r->map = NULL;
+	r->run_next = g_large_free;
+	g_large_free = r;
+}
+
+// ---------------- Medium page runs ----------------
+
+static size_t run_list(size_t bytes)
+{
+	size_t pages = bytes / MALLOC_LARGE_GRAIN;
+	return pages < MEDIUM_LISTS - 1 ? pages : MEDIUM_LISTS - 1;
+}
+
+// Page map entries of a run: its first and its last 4 KiB page.
+static void run_register(t_large *r)
+{
+	large_set(r->map, r);
+	large_set((char *)r->map + r->zone.capacity - MALLOC_LARGE_GRAIN, r);
+}
+
+static void run_insert(t_large *r)
+{
+	size_t i = run_list(r->zone.capacity);
+	r->block.free = 1;
+	r->run_prev = NULL;
+	r->run_next = g_runs[i];
+	if (g_runs[i])
+		g_runs[i]->run_prev = r;
+	g_runs[i] = r;
+	g_runs_mask[i / 64] |= 1UL << (i % 64);
+}
+
+static void run_remove(t_large *r)
+{
+	size_t i = run_list(r->zone.capacity);
+	if (r->run_prev)
+		r->run_prev->run_next = r->run_next;
+	else
+		g_runs[i] = r->run_next;
+	if (r->run_next)
+		r->run_next->run_prev = r->run_prev;
+	if (!g_runs[i])
+		g_runs_mask[i / 64] &= ~(1UL << (i % 64));
+	r->run_next = r->run_prev = NULL;
+	r->block.free = 0;
+}
+
+// Smallest free run of at least `bytes`: exact-size lists through the
+// bitmap, first fit in the list of long runs.
+static t_large *run_find(size_t bytes)
+{
+	size_t i = run_list(bytes);
+	for (size_t w = i / 64; w < MEDIUM_WORDS; ++w)
+	{
+		uint64_t bits = g_runs_mask[w];
+		if (w == i / 64)
+			bits &= ~0UL << (i % 64);
+		if (!bits)
+			continue;
+		size_t list = w * 64 + (size_t)__builtin_ctzl(bits);
+		if (list < MEDIUM_LISTS - 1)
+			return g_runs[list];
+		for (t_large *r = g_runs[list]; r; r = r->run_next)
+			if (r->zone.capacity >= bytes)
+				return r;
+		return NULL;
+	}
+	return NULL;
+}
+
+static t_large *chunk_new(void)
+{
+	t_large *r = large_record();
+	if (!r)
+		return NULL;
+	r->map = malloc_map_small(MALLOC_MEDIUM_CHUNK); // runs are below a huge page
+	if (!r->map || !large_slot(r->map, 1) ||
+		!large_slot((char *)r->map + MALLOC_MEDIUM_CHUNK - MALLOC_LARGE_GRAIN, 1))
+	{
+		if (r->map)
+			munmap(r->map, MALLOC_MEDIUM_CHUNK);
+		large_recycle(r);
+		return NULL;
+	}
+	r->chunk = r->map;
+	r->zone.capacity = MALLOC_MEDIUM_CHUNK;
+	run_register(r);
+	run_insert(r);
+	g_empty_chunks++;
+	return r;
+}
+
+// Take a run of `bytes` (page multiple), splitting the remainder off.
+static t_large *run_take(size_t bytes)
+{
+	t_large *r = run_find(bytes);
+	if (!r && !(r = chunk_new()))
+		return NULL;
+	run_remove(r);
+	if (r->map == r->chunk && r->zone.capacity == MALLOC_MEDIUM_CHUNK)
+		g_empty_chunks--;
+	if (r->zone.capacity > bytes)
+	{
+		t_large *rest = large_record();
+		if (!rest)
+		{
+			g_empty_chunks += r->map == r->chunk && r->zone.capacity == MALLOC_MEDIUM_CHUNK;
+			run_insert(r);
+			return NULL;
+		}
+		rest->map = (char *)r->map + bytes;
+		rest->chunk = r->chunk;
+		rest->zone.capacity = r->zone.capacity - bytes;
+		r->zone.capacity = bytes;
+		run_register(rest);
+		run_insert(rest);
+	}
+	run_register(r);
+	return r;
+}
+
+// Merge a freed run with its free neighbours of the same chunk. A chunk left
+// entirely free is kept as a spare (no map / fault churn when the heap
+// oscillates around a chunk boundary), a second one is unmapped.
+static void run_release(t_large *r)
+{
+	t_large *left = large_get((char *)r->map - MALLOC_LARGE_GRAIN);
+	if (left && left != r && left->block.free && left->chunk == r->chunk)
+	{
+		run_remove(left);
+		large_set(r->map, LARGE_RETIRED);
+		large_set((char *)r->map - MALLOC_LARGE_GRAIN, LARGE_RETIRED);
+		left->zone.capacity += r->zone.capacity;
+		large_recycle(r);
+		r = left;
+	}
+	char *end = (char *)r->map + r->zone.capacity;
+	t_large *right = large_get(end);
+	if (right && right->block.free && right->chunk == r->chunk)
+	{
+		run_remove(right);
+		large_set(end, LARGE_RETIRED);
+		large_set(end - MALLOC_LARGE_GRAIN, LARGE_RETIRED);
+		r->zone.capacity += right->zone.capacity;
+		large_recycle(right);
+	}
+	if (r->map == r->chunk && r->zone.capacity == MALLOC_MEDIUM_CHUNK && g_empty_chunks++)
+	{
+		g_empty_chunks--;
+		for (size_t off = 0; off < MALLOC_MEDIUM_CHUNK; off += MALLOC_LARGE_GRAIN)
+			large_set(r->chunk + off, NULL); // the address range may be mapped again
+		munmap(r->chunk, MALLOC_MEDIUM_CHUNK);
+		large_recycle(r);
+		return;
+	}
+	run_register(r);
+	r->zone.used = 0;
+	run_insert(r);
+}
+
+// ---------------- LARGE blocks ----------------
+
+t_block *malloc_large_alloc(size_t size, size_t requested)
+{
+	size_t map_size = ALIGN_UP(size, malloc_pagesize());
+	t_large *r = NULL;
+	if (map_size <= MALLOC_MEDIUM_MAX)
+		r = run_take(map_size);
+	else
+	{
+#ifdef MALLOC_HUGEPAGE
+		if (map_size >= MALLOC_HUGE_PAGE) // smaller blocks would fault a whole huge page
+			map_size = ALIGN_UP(map_size, MALLOC_HUGE_PAGE);
+#endif
+		if (!(r = large_record()))
+			return NULL;
+		r->map = malloc_map(map_size);
+		if (!r->map || !large_slot(r->map, 1))
+		{
+			if (r->map)
+				munmap(r->map, map_size);
+			large_recycle(r);
+			return NULL;
+		}
+		r->zone.capacity = map_size;
+	}
+	if (!r)
+		return NULL;
+	t_zone *z = &r->zone;
+	t_block *b = &r->block;
+	z->used = size;
+	z->data_offset = 0;
+	z->blocks = z->tail = b;
+	*b = (t_block){.size = size, .requested = requested, .zone = z};
+	zone_link(z);
+	large_set(r->map, r);
+	return b;
+}
+
+void malloc_large_free(t_block *b)
+{
+	t_large *r = (t_large *)b->zone;
+	zone_unlink(&r->zone);
+	if (r->chunk)
+	{
+		run_release(r);
+		return;
+	}
+	large_set(r->map, NULL);
+	munmap(r->map, r->zone.capacity);
+	large_recycle(r);
+}
+
+t_block *malloc_large_find(const void *ptr)
+{
+	t_large *r = large_get(ptr);
+	return r && r->map == ptr && !r->block.free ? &r->block : NULL; // free runs are not blocks
+}
+
+int malloc_large_stale(const void *ptr)
+{
+	if ((uintptr_t)ptr & (MALLOC_LARGE_GRAIN - 1))
+		return 0;
+	t_large *r = large_entry(ptr);
+	return r == LARGE_RETIRED || (r && (r->map != ptr || r->block.free));
+}
@@ -6,7 +6,7 @@
 /*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2025/09/17 11:21:08 by tamigore          #+#    #+#             */
-/*   Updated: 2025/09/28 15:12:02 by tamigore         ###   ########.fr       */
+/*   Updated: 2026/10/20 00:37:52 by tamigore         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
@@ -18,21 +18,24 @@
 #endif
 
 #include "print.h"
+#include "malloc_percpu.h"
+#include "malloc_stats.h"
+#include "malloc_profile.h"
+#include "malloc_sizemap.h"
 
 t_zone *g_zones = NULL;
+static size_t g_zones_created[2]; // TINY/SMALL zones mapped so far, sizes the next one
 
 static t_zone_type classify(size_t size)
 {
-	size_t tiny = TINY_MAX;
-	size_t small = SMALL_MAX;
-	if (size <= tiny)
+	if (size <= TINY_MAX)
 		return ZONE_TINY;
-	if (size <= small)
+	if (size <= SMALL_MAX)
 		return ZONE_SMALL;
 	return ZONE_LARGE;
 }
 
-static size_t pagesize(void)
+size_t malloc_pagesize(void)
 {
 	static size_t ps = 0;
 	if (ps == 0)
@@ -48,71 +51,36 @@ static size_t pagesize(void)
 	return ps;
 }
 
-// Decide dynamic thresholds as page-size multiples.
-// Strategy:
-//  - Base tiny target = 128 (historical). Round up to next divisor of page size such that
-//    at least 64 tiny blocks fit into one multi-page zone allocation.
-//  - Base small target = 4096 (historical). Ensure small_max >= 4 * tiny_max and is a
-//    multiple of page size.
-// We cache results after first computation.
+// Thresholds of the page size the library was built for, chosen by
+// tools/gen_classes.c (make PAGE_SIZE=...). A different page size at run time
+// only changes how tightly zones are packed.
 size_t malloc_tiny_max(void)
 {
-	static size_t cached = 0; // function-local cache
-	if (cached)
-		return cached;
-	size_t ps = pagesize();
-	size_t base = 128UL;
-	// If page size < base fallback to base aligned to 16.
-	if (ps <= base)
-	{
-		cached = ALIGN_UP(base, MALLOC_ALIGN);
-		return cached;
-	}
-	// Choose a divisor of page size near base
-	size_t blocks_per_page_target = ps / base; // e.g., 4096/128 = 32
-	if (blocks_per_page_target == 0)
-		blocks_per_page_target = 1;
-	size_t candidate = ps / blocks_per_page_target; // 4096/32 = 128
-	// Round candidate up to alignment
-	candidate = ALIGN_UP(candidate, MALLOC_ALIGN);
-	// Guarantee candidate divides page size (so N * candidate = page size)
-	while (ps % candidate != 0)
-		candidate += MALLOC_ALIGN;
-	cached = candidate;
-	return cached;
+	return TINY_MAX;
 }
 
 size_t malloc_small_max(void)
 {
-	static size_t cached = 0; // function-local cache (non-global at file scope)
-	if (cached)
-		return cached;
-	size_t ps = pagesize();
-	size_t tiny = malloc_tiny_max();
-	size_t base = 4096UL;
-	// Ensure small_max at least 4 * tiny and a multiple of page size.
-	size_t min_small = tiny * 4;
-	if (base < min_small)
-		base = min_small;
-	// Round base up to page size multiple.
-	size_t candidate = ALIGN_UP(base, ps);
-	cached = candidate;
-	return cached;
+	return SMALL_MAX;
 }
 
+// TINY/SMALL only: LARGE blocks are mapped by malloc_large_alloc.
 static size_t zone_allocation_size(t_zone_type t, size_t request)
 {
-	size_t ps = pagesize();
-	if (t == ZONE_LARGE)
-	{
-		size_t need = ALIGN_UP(sizeof(t_zone) + sizeof(t_block) + request, ps);
-		return need;
-	}
+	size_t ps = malloc_pagesize();
 	size_t max_block = (t == ZONE_TINY) ? TINY_MAX : SMALL_MAX;
-	size_t one = sizeof(t_block) + max_block;
-	// Keep zone size a multiple of page size large enough for ~100 blocks
-	size_t raw = one * 100 + sizeof(t_zone);
-	return ALIGN_UP(raw, ps);
+	size_t size = sizeof(t_zone) + (sizeof(t_block) + max_block) * MALLOC_ZONE_FIRST_BLOCKS;
+	// Double per zone already mapped: the number of mappings grows with the
+	// log of the heap until MALLOC_ZONE_MAX_SIZE is reached.
+	for (size_t n = g_zones_created[t]; n && size < MALLOC_ZONE_MAX_SIZE; --n)
+		size *= 2;
+	if (size > MALLOC_ZONE_MAX_SIZE)
+		size = MALLOC_ZONE_MAX_SIZE;
+	size_t need = sizeof(t_zone) + sizeof(t_block) + request;
+#ifdef MALLOC_HUGEPAGE
+	ps = MALLOC_HUGE_PAGE; // whole huge pages once committed
+#endif
+	return ALIGN_UP(size > need ? size : need, ps);
 }
 
 char *zone_type_to_string(t_zone_type t)
@@ -127,9 +95,12 @@ char *zone_type_to_string(t_zone_type t)
 static t_zone *create_zone(t_zone_type t, size_t request)
 {
 	size_t alloc = zone_allocation_size(t, request);
-	void *mem = mmap(NULL, alloc, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-	if (mem == MAP_FAILED)
+	void *mem = malloc_reserve_commit(alloc);
+	if (!mem)
+		mem = malloc_map(alloc);
+	if (!mem)
 		return NULL;
+	g_zones_created[t]++;
 	t_zone *z = (t_zone *)mem;
 	z->type = t;
 	// Align data region start
@@ -138,22 +109,12 @@ static t_zone *create_zone(t_zone_type t, size_t request)
 	z->data_offset = aligned_off;
 	z->capacity = alloc - aligned_off;
 	z->used = 0;
-	z->next = NULL;
 	z->blocks = NULL;
 	z->tail = NULL;
-	z->bins = NULL;
-	z->bin_count = 0;
-	// Insert at list head
-	z->next = g_zones;
-	g_zones = z;
+	zone_link(z);
 	return z;
 }
 
-static void *block_payload(t_block *b)
-{
-	return (void *)((char *)b + sizeof(t_block));
-}
-
 static inline int block_in_zone_local(t_zone *z, t_block *b)
 {
 	char *zs = (char *)z + z->data_offset;
@@ -175,6 +136,7 @@ static void split_block_if_large(t_zone *z, t_block *b, size_t needed)
 		nb->size = old_size - needed - sizeof(t_block);
 		nb->requested = 0;
 		nb->free = 1;
+		nb->flags = 0;
 		nb->prev = b;
 		nb->next = b->next;
 		nb->bin_next = nb->bin_prev = NULL;
@@ -187,6 +149,7 @@ static void split_block_if_large(t_zone *z, t_block *b, size_t needed)
 		if (z && z->tail == b)
 			z->tail = nb;
 		malloc_bin_insert(nb);
+		MALLOC_STATS_SPLIT(b);
 	}
 }
 
@@ -205,6 +168,7 @@ static t_block *append_block(t_zone *z, size_t size, size_t requested)
 	b->size = size;
 	b->requested = requested;
 	b->free = 0;
+	b->flags = 0;
 	b->prev = z->tail;
 	b->next = NULL;
 	if (!z->blocks)
@@ -224,44 +188,25 @@ static t_block *alloc_from_zone(t_zone *z, size_t size, size_t requested)
 	return b;
 }
 
-static t_block *allocate(size_t requested)
+// The caller counts the allocation under *path (the per-CPU refill does not).
+static t_block *allocate(size_t requested, t_malloc_alloc_path *path)
 {
 	size_t aligned = ALIGN_UP(requested, MALLOC_ALIGN);
 	t_zone_type t = classify(aligned);
 	if (t == ZONE_LARGE)
 	{
-		size_t alloc = sizeof(t_zone) + sizeof(t_block) + aligned;
-		size_t ps = pagesize();
-		alloc = ALIGN_UP(alloc, ps);
-		void *mem = mmap(NULL, alloc, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-		if (mem == MAP_FAILED)
-			return NULL;
-		t_zone *z = (t_zone *)mem;
-		z->type = ZONE_LARGE;
-		// Large zone: header followed by aligned data region
-		size_t raw_off = sizeof(t_zone);
-		size_t aligned_off = ALIGN_UP(raw_off, MALLOC_ALIGN);
-		z->data_offset = aligned_off;
-		z->capacity = alloc - aligned_off;
-		z->used = aligned;
-		z->next = g_zones;
-		g_zones = z;
-		z->blocks = (t_block *)((char *)z + z->data_offset);
-		z->tail = z->blocks;
-		z->bins = NULL;
-		z->bin_count = 0;
-		t_block *b = z->blocks;
-		b->size = aligned;
-		b->requested = requested;
-		b->free = 0;
-		b->prev = NULL;
-		b->next = NULL;
-		b->bin_next = b->bin_prev = NULL;
-		b->zone = z;
-		return b;
+		*path = MALLOC_PATH_ZONE;
+		return malloc_large_alloc(aligned, requested);
 	}
-	// Try bins first (only for non-large)
-	t_block *reuse = malloc_bin_take(aligned, t);
+	// TINY/SMALL requests take their whole size class: a freed block then fits
+	// the next request of the class exactly.
+	aligned = malloc_class_bytes(malloc_class_lookup(aligned));
+	// Quick lists, then bins; a bin miss first merges the parked blocks.
+	t_block *reuse = malloc_quick_take(aligned, t);
+	if (!reuse)
+		reuse = malloc_bin_take(aligned, t);
+	if (!reuse && malloc_quick_flush())
+		reuse = malloc_bin_take(aligned, t);
 	if (reuse)
 	{
 		reuse->requested = requested;
@@ -269,6 +214,7 @@ static t_block *allocate(size_t requested)
 		if (reuse->zone)
 			reuse->zone->used += aligned;
 		split_block_if_large(reuse->zone, reuse, aligned);
+		*path = MALLOC_PATH_BIN;
 		return reuse;
 	}
 	// find existing zone of that type with space (append path)
@@ -280,6 +226,7 @@ static t_block *allocate(size_t requested)
 			if (b)
 			{
 				split_block_if_large(z, b, aligned);
+				*path = MALLOC_PATH_APPEND;
 				return b;
 			}
 		}
@@ -290,10 +237,11 @@ static t_block *allocate(size_t requested)
 	t_block *nb = alloc_from_zone(z, aligned, requested);
 	if (nb)
 		split_block_if_large(z, nb, aligned);
+	*path = MALLOC_PATH_ZONE;
 	return nb;
 }
 
-void *malloc(size_t size)
+static void *malloc_locked(size_t size)
 {
 	malloc_lock();
 	if (size == 0)
@@ -304,14 +252,52 @@ void *malloc(size_t size)
 		malloc_unlock();
 		return NULL;
 	}
-	t_block *b = allocate(size);
+	t_malloc_alloc_path path;
+	t_block *b = allocate(size, &path);
 	if (!b)
 	{
 		malloc_unlock();
 		return NULL;
 	}
+	MALLOC_STATS_ALLOC(b, path);
 	void *p = block_payload(b);
 	// Alignment should already be guaranteed by header alignment + size alignment.
 	malloc_unlock();
 	return p;
-}
\ No newline at end of file
+}
+
+#ifdef MALLOC_PERCPU
+// Blocks enter the cache uncounted: malloc_percpu_pop() counts the hit.
+size_t malloc_cache_fill(size_t size, void **out, size_t n)
+{
+	t_malloc_alloc_path path;
+	size_t got = 0;
+	malloc_lock();
+	for (; got < n; ++got)
+	{
+		t_block *b = allocate(size, &path);
+		if (!b)
+			break;
+		b->flags |= BLOCK_F_CACHED;
+		out[got] = block_payload(b);
+	}
+	malloc_unlock();
+	return got;
+}
+#endif
+
+void *malloc(size_t size)
+{
+	void *p = NULL;
+#ifdef MALLOC_PERCPU
+	p = malloc_percpu_pop(size);
+#endif
+	if (!p)
+		p = malloc_locked(size);
+#ifdef MALLOC_PROFILE
+	if (p)
+		malloc_profile_account(p, size);
+#endif
+	MALLOC_TRACE_EVENT(MALLOC_TRACE_MALLOC, NULL, size, p);
+	return p;
+}
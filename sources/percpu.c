@@ -0,0 +1,462 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   percpu.c                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 10:02:11 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 15:20:03 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_malloc.h"
+#include "malloc_percpu.h"
+#include "malloc_sizemap.h"
+
+// PERCPU_CLASSES is spelled out in the public header: keep it in step with the
+// generated class table.
+#define PERCPU_GEN_CLASS(k) PERCPU_GEN_CLASS_(k)
+#define PERCPU_GEN_CLASS_(k) MALLOC_GEN_CLASS_POW2_##k
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+_Static_assert(PERCPU_CLASSES == PERCPU_GEN_CLASS(PERCPU_MAX_SHIFT) + 1, "PERCPU_CLASSES != class of PERCPU_MAX_SIZE + 1");
+#endif
+
+#if defined(MALLOC_PERCPU) && defined(__linux__) && defined(__x86_64__)
+
+#include <stdint.h>
+#include <sys/syscall.h>
+#if defined(__has_include) && __has_include(<sys/rseq.h>)
+# include <sys/rseq.h> // glibc >= 2.35 registers rseq itself (__rseq_offset)
+# define PERCPU_GLIBC_RSEQ 1
+#else
+# include <linux/rseq.h>
+# define RSEQ_SIG 0x53053053
+#endif
+
+// One slab per CPU: counts first, then the per-class object stacks.
+// Counts are 32-bit so the commit is a single movl.
+typedef struct s_percpu_slab
+{
+	uint32_t count[PERCPU_CLASSES];
+	void *slots[PERCPU_CLASSES][PERCPU_DEPTH];
+#ifdef MALLOC_STATS
+	uint64_t hits[PERCPU_CLASSES];	  // pops (relaxed atomics, outside the rseq section)
+	uint64_t returns[PERCPU_CLASSES]; // pushes
+#endif
+} __attribute__((aligned(64))) t_percpu_slab;
+
+#define PERCPU_SLOTS_OFFSET (PERCPU_CLASSES * sizeof(uint32_t))
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+_Static_assert(offsetof(t_percpu_slab, slots) == PERCPU_SLOTS_OFFSET, "slot offset used by rseq asm");
+#endif
+
+static struct s_percpu_state
+{
+	pthread_once_t once;
+	t_percpu_slab *slabs; // ncpu slabs, mmap'd (never from the managed heap)
+	size_t ncpu;
+} g_percpu = {PTHREAD_ONCE_INIT, NULL, 0};
+
+// initial-exec: the library is loaded at startup (link or LD_PRELOAD), and the
+// dynamic TLS model could call back into malloc through __tls_get_addr.
+#define PERCPU_TLS __thread __attribute__((tls_model("initial-exec")))
+
+static PERCPU_TLS struct rseq *t_rseq;	  // registered area for this thread
+static PERCPU_TLS int t_rseq_failed;	  // registration impossible => locked path
+static PERCPU_TLS struct rseq t_rseq_own; // used when libc did not register one
+
+static void percpu_init(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_CONF);
+	if (n <= 0)
+		return;
+	size_t bytes = (size_t)n * sizeof(t_percpu_slab);
+	void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return;
+	g_percpu.ncpu = (size_t)n;
+	__atomic_store_n(&g_percpu.slabs, (t_percpu_slab *)mem, __ATOMIC_RELEASE);
+}
+
+static struct rseq *percpu_rseq(void)
+{
+	if (t_rseq)
+		return t_rseq;
+	if (t_rseq_failed)
+		return NULL;
+#ifdef PERCPU_GLIBC_RSEQ
+	if (__rseq_size > 0)
+	{
+		struct rseq *rs = (struct rseq *)((char *)__builtin_thread_pointer() + __rseq_offset);
+		if ((int32_t)rs->cpu_id >= 0)
+			return (t_rseq = rs);
+	}
+#endif
+	t_rseq_own.cpu_id = (uint32_t)RSEQ_CPU_ID_UNINITIALIZED;
+	if (syscall(__NR_rseq, &t_rseq_own, sizeof(t_rseq_own), 0, RSEQ_SIG) == 0)
+		return (t_rseq = &t_rseq_own);
+	t_rseq_failed = 1;
+	return NULL;
+}
+
+// rseq critical section descriptor + abort handler (signature precedes it).
+#define PERCPU_RSEQ_CS(label, start, post_commit, abort)            \
+	".pushsection __rseq_cs, \"aw\"\n\t"                             \
+	".balign 32\n\t" label ":\n\t"                                   \
+	".long 0x0, 0x0\n\t"                                             \
+	".quad " start ", (" post_commit " - " start "), " abort "\n\t" \
+	".popsection\n\t"
+#define PERCPU_RSEQ_ABORT(label, target)      \
+	".pushsection __rseq_failure, \"ax\"\n\t" \
+	".byte 0x0f, 0xb9, 0x3d\n\t"              \
+	".long 0x53053053\n\t" label ":\n\t"      \
+	"jmp %l[" target "]\n\t"                  \
+	".popsection\n\t"
+
+// Pop the top object of class `cls` on the current CPU. Returns 1 and stores
+// the object in *out, 0 when the stack is empty. Restarted on preemption,
+// migration or signal delivery before the count store commits.
+static int percpu_slab_pop(struct rseq *rs, size_t cls, void **out)
+{
+	t_percpu_slab *slabs = g_percpu.slabs;
+	size_t ncpu = g_percpu.ncpu;
+retry:
+	__asm__ __volatile__ goto(
+		PERCPU_RSEQ_CS("3", "1f", "2f", "4f")
+		"leaq 3b(%%rip), %%rax\n\t"
+		"movq %%rax, %[rseq_cs]\n\t"
+		"1:\n\t"
+		"movl %[cpu_id], %%eax\n\t"
+		"cmpq %[ncpu], %%rax\n\t"
+		"jae %l[empty]\n\t"
+		"imulq %[stride], %%rax\n\t"
+		"addq %[slabs], %%rax\n\t"
+		"movl (%%rax,%[cls],4), %%ecx\n\t"
+		"testl %%ecx, %%ecx\n\t"
+		"jz %l[empty]\n\t"
+		"decl %%ecx\n\t"
+		"movq %[cls], %%rdx\n\t"
+		"imulq %[depth], %%rdx\n\t"
+		"addq %%rcx, %%rdx\n\t"
+		"movq %c[slots](%%rax,%%rdx,8), %%rdx\n\t"
+		"movq %%rdx, (%[out])\n\t"
+		"movl %%ecx, (%%rax,%[cls],4)\n\t" // commit
+		"2:\n\t"
+		PERCPU_RSEQ_ABORT("4", "abort")
+		:
+		: [cpu_id] "m"(rs->cpu_id), [rseq_cs] "m"(rs->rseq_cs),
+		  [ncpu] "r"(ncpu), [stride] "i"(sizeof(t_percpu_slab)),
+		  [slabs] "r"(slabs), [cls] "r"(cls), [out] "r"(out),
+		  [depth] "i"(PERCPU_DEPTH), [slots] "i"(PERCPU_SLOTS_OFFSET)
+		: "memory", "cc", "rax", "rcx", "rdx"
+		: empty, abort);
+	return 1;
+empty:
+	return 0;
+abort:
+	goto retry;
+}
+
+// Push `obj` on class `cls` of the current CPU. Returns 0 when the stack is full.
+static int percpu_slab_push(struct rseq *rs, size_t cls, void *obj)
+{
+	t_percpu_slab *slabs = g_percpu.slabs;
+	size_t ncpu = g_percpu.ncpu;
+retry:
+	__asm__ __volatile__ goto(
+		PERCPU_RSEQ_CS("3", "1f", "2f", "4f")
+		"leaq 3b(%%rip), %%rax\n\t"
+		"movq %%rax, %[rseq_cs]\n\t"
+		"1:\n\t"
+		"movl %[cpu_id], %%eax\n\t"
+		"cmpq %[ncpu], %%rax\n\t"
+		"jae %l[full]\n\t"
+		"imulq %[stride], %%rax\n\t"
+		"addq %[slabs], %%rax\n\t"
+		"movl (%%rax,%[cls],4), %%ecx\n\t"
+		"cmpl %[depth], %%ecx\n\t"
+		"jae %l[full]\n\t"
+		"movq %[cls], %%rdx\n\t"
+		"imulq %[depth], %%rdx\n\t"
+		"addq %%rcx, %%rdx\n\t"
+		"movq %[obj], %c[slots](%%rax,%%rdx,8)\n\t"
+		"incl %%ecx\n\t"
+		"movl %%ecx, (%%rax,%[cls],4)\n\t" // commit
+		"2:\n\t"
+		PERCPU_RSEQ_ABORT("4", "abort")
+		:
+		: [cpu_id] "m"(rs->cpu_id), [rseq_cs] "m"(rs->rseq_cs),
+		  [ncpu] "r"(ncpu), [stride] "i"(sizeof(t_percpu_slab)),
+		  [slabs] "r"(slabs), [cls] "r"(cls), [obj] "r"(obj),
+		  [depth] "i"(PERCPU_DEPTH), [slots] "i"(PERCPU_SLOTS_OFFSET)
+		: "memory", "cc", "rax", "rcx", "rdx"
+		: full, abort);
+	return 1;
+full:
+	return 0;
+abort:
+	goto retry;
+}
+
+
+#ifdef MALLOC_STATS
+// Charged to whichever CPU we run on now; the atomic keeps a migration harmless.
+static void percpu_count(struct rseq *rs, int is_pop, size_t cls)
+{
+	size_t cpu = rs->cpu_id;
+	if (cpu >= g_percpu.ncpu)
+		return;
+	t_percpu_slab *slab = &g_percpu.slabs[cpu];
+	__atomic_fetch_add(is_pop ? &slab->hits[cls] : &slab->returns[cls], 1, __ATOMIC_RELAXED);
+}
+
+void malloc_percpu_stats(uint64_t *hits, uint64_t *returns)
+{
+	t_percpu_slab *slabs = __atomic_load_n(&g_percpu.slabs, __ATOMIC_ACQUIRE);
+	for (size_t i = 0; i < PERCPU_CLASSES; ++i)
+	{
+		hits[i] = returns[i] = 0;
+		for (size_t c = 0; slabs && c < g_percpu.ncpu; ++c)
+		{
+			hits[i] += __atomic_load_n(&slabs[c].hits[i], __ATOMIC_RELAXED);
+			returns[i] += __atomic_load_n(&slabs[c].returns[i], __ATOMIC_RELAXED);
+		}
+	}
+}
+#else
+# define percpu_count(rs, is_pop, cls) ((void)0)
+#endif
+
+// ---------------- magazines and depot ----------------
+
+typedef struct s_magazine
+{
+	struct s_magazine *next;
+	size_t count;
+	void *objs[PERCPU_MAG_SIZE];
+} t_magazine;
+
+// Magazine records are mmap'd a page at a time and never unmapped: at most
+// PERCPU_DEPOT_MAGS per class plus one per thread in an exchange. The depot
+// is guarded by malloc_depot_lock().
+static struct s_depot
+{
+	t_magazine *full[PERCPU_CLASSES];
+	size_t nfull[PERCPU_CLASSES];
+	t_magazine *empty;
+} g_depot;
+
+static t_magazine *depot_get(size_t cls, int want_full)
+{
+	malloc_depot_lock();
+	t_magazine **list = want_full ? &g_depot.full[cls] : &g_depot.empty;
+	if (!*list && !want_full)
+	{
+		// Map the new records without the lock; if another thread refilled the
+		// list meanwhile, the extras simply stay on it.
+		malloc_depot_unlock();
+		size_t ps = malloc_pagesize(), n = ps / sizeof(t_magazine);
+		t_magazine *page = mmap(NULL, ps, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		for (size_t i = 0; page != MAP_FAILED && i + 1 < n; ++i)
+			page[i].next = &page[i + 1];
+		malloc_depot_lock();
+		if (page != MAP_FAILED && n)
+		{
+			page[n - 1].next = g_depot.empty;
+			g_depot.empty = page;
+		}
+	}
+	t_magazine *m = *list;
+	if (m)
+	{
+		*list = m->next;
+		if (want_full)
+			g_depot.nfull[cls]--;
+	}
+	malloc_depot_unlock();
+	return m;
+}
+
+// Store a magazine; 0 when the class already has PERCPU_DEPOT_MAGS full ones.
+static int depot_put(size_t cls, t_magazine *m)
+{
+	int stored = 1;
+	malloc_depot_lock();
+	if (!m->count)
+	{
+		m->next = g_depot.empty;
+		g_depot.empty = m;
+	}
+	else if (g_depot.nfull[cls] < PERCPU_DEPOT_MAGS)
+	{
+		m->next = g_depot.full[cls];
+		g_depot.full[cls] = m;
+		g_depot.nfull[cls]++;
+	}
+	else
+		stored = 0;
+	malloc_depot_unlock();
+	return stored;
+}
+
+// Empty stack: load a magazine from the depot, or from the heap, into it and
+// keep one object for the caller. Objects that no longer fit (the thread moved
+// to a CPU whose stack is full) go back to the heap.
+static void *percpu_refill(struct rseq *rs, size_t cls)
+{
+	t_magazine *m = depot_get(cls, 1);
+	if (!m)
+	{
+		if (!(m = depot_get(cls, 0)))
+			return NULL;
+		m->count = malloc_cache_fill(malloc_class_size(cls), m->objs, PERCPU_MAG_SIZE);
+		if (!m->count)
+		{
+			depot_put(cls, m);
+			return NULL;
+		}
+	}
+	void *p = m->objs[--m->count];
+	while (m->count && percpu_slab_push(rs, cls, m->objs[m->count - 1]))
+		m->count--;
+	if (m->count)
+		malloc_cache_release(m->objs, m->count);
+	m->count = 0;
+	depot_put(cls, m);
+	return p;
+}
+
+// Full stack: move a magazine of its objects to the depot, or to the heap when
+// the depot is full. Returns 0 when no magazine record is available.
+static int percpu_spill(struct rseq *rs, size_t cls)
+{
+	t_magazine *m = depot_get(cls, 0);
+	if (!m)
+		return 0;
+	m->count = 0;
+	while (m->count < PERCPU_MAG_SIZE && percpu_slab_pop(rs, cls, &m->objs[m->count]))
+		m->count++;
+	if (!depot_put(cls, m))
+	{
+		malloc_cache_release(m->objs, m->count);
+		m->count = 0;
+		depot_put(cls, m);
+	}
+	return 1;
+}
+
+void *malloc_percpu_pop(size_t size)
+{
+	if (size == 0)
+		size = 1;
+	size_t aligned = ALIGN_UP(size, MALLOC_ALIGN);
+	if (aligned > PERCPU_MAX_SIZE || !__atomic_load_n(&g_percpu.slabs, __ATOMIC_ACQUIRE))
+		return NULL;
+	struct rseq *rs = percpu_rseq();
+	void *p;
+	size_t cls = malloc_class_lookup(aligned);
+	if (!rs)
+		return NULL;
+	if (!percpu_slab_pop(rs, cls, &p) && !(p = percpu_refill(rs, cls)))
+		return NULL;
+	percpu_count(rs, 1, cls);
+	t_block *b = ptr_to_block(p);
+	b->flags &= (unsigned char)~BLOCK_F_CACHED;
+	b->requested = size;
+	return p;
+}
+
+int malloc_percpu_push(void *ptr)
+{
+	// Only blocks of reserved TINY/SMALL zones are cached. The range checks run
+	// before any header is read, so a foreign pointer is never dereferenced
+	// here: it takes the locked path, which validates it.
+	t_block *b = (t_block *)((char *)ptr - sizeof(t_block));
+	if (!malloc_reserve_owns(b) || !malloc_reserve_owns((char *)ptr - 1))
+		return 0;
+	t_zone *z = b->zone;
+	// Sampled blocks take the locked path too: free() unrecords them there.
+	if (!malloc_reserve_owns(z) || z->type == ZONE_LARGE || b->free ||
+		(b->flags & (BLOCK_F_QUICK | BLOCK_F_SAMPLED)) || b->size > PERCPU_MAX_SIZE)
+		return 0;
+	if ((char *)b < (char *)z + z->data_offset || (char *)b >= (char *)z + z->data_offset + z->capacity)
+		return 0;
+	if (b->flags & BLOCK_F_CACHED)
+		return 1; // double free of a cached block: ignore like free() does
+	pthread_once(&g_percpu.once, percpu_init);
+	if (!g_percpu.slabs)
+		return 0;
+	struct rseq *rs = percpu_rseq();
+	if (!rs)
+		return 0;
+	// A block may be larger than its class (reused without a split): it serves
+	// the largest class it covers.
+	size_t cls = malloc_class_lookup_floor(b->size);
+	b->flags |= BLOCK_F_CACHED;
+	if (percpu_slab_push(rs, cls, ptr) || (percpu_spill(rs, cls) && percpu_slab_push(rs, cls, ptr)))
+	{
+		percpu_count(rs, 0, cls);
+		return 1;
+	}
+	b->flags &= (unsigned char)~BLOCK_F_CACHED;
+	return 0;
+}
+
+void malloc_percpu_drain(void)
+{
+	if (!__atomic_load_n(&g_percpu.slabs, __ATOMIC_ACQUIRE))
+		return;
+	struct rseq *rs = percpu_rseq();
+	if (!rs)
+		return;
+	void *objs[PERCPU_MAG_SIZE];
+	for (size_t cls = 0; cls < PERCPU_CLASSES; ++cls)
+	{
+		size_t n;
+		do
+		{
+			n = 0;
+			while (n < PERCPU_MAG_SIZE && percpu_slab_pop(rs, cls, &objs[n]))
+				n++;
+			if (n)
+				malloc_cache_release(objs, n);
+		} while (n == PERCPU_MAG_SIZE);
+		t_magazine *m;
+		while ((m = depot_get(cls, 1)))
+		{
+			malloc_cache_release(m->objs, m->count);
+			m->count = 0;
+			depot_put(cls, m);
+		}
+	}
+}
+
+#elif defined(MALLOC_PERCPU)
+
+// No rseq on this platform: always take the locked path.
+# ifdef MALLOC_STATS
+void malloc_percpu_stats(uint64_t *hits, uint64_t *returns)
+{
+	for (size_t i = 0; i < PERCPU_CLASSES; ++i)
+		hits[i] = returns[i] = 0;
+}
+# endif
+
+void *malloc_percpu_pop(size_t size)
+{
+	(void)size;
+	return NULL;
+}
+
+int malloc_percpu_push(void *ptr)
+{
+	(void)ptr;
+	return 0;
+}
+
+void malloc_percpu_drain(void)
+{
+}
+
+#endif
@@ -12,20 +12,65 @@
 
 #include "print.h"
 
-static void print_str(const char *s)
+void print_buf_init(t_print_buf *pb, int fd, char *data, size_t cap)
 {
-    while (*s)
-        write(1, s++, 1);
+    pb->fd = fd;
+    pb->data = data;
+    pb->cap = cap;
+    pb->len = 0;
+    pb->error = 0;
 }
 
-static void print_int(int n)
+void print_buf_flush(t_print_buf *pb)
+{
+    size_t off = 0;
+    while (off < pb->len)
+    {
+        ssize_t n = write(pb->fd, pb->data + off, pb->len - off);
+        if (n <= 0)
+        {
+            pb->error = 1;
+            break;
+        }
+        off += (size_t)n;
+    }
+    pb->len = 0;
+}
+
+void print_buf_write(t_print_buf *pb, const void *src, size_t n)
+{
+    const char *s = (const char *)src;
+    while (n)
+    {
+        if (pb->len == pb->cap)
+            print_buf_flush(pb);
+        size_t chunk = pb->cap - pb->len;
+        if (chunk > n)
+            chunk = n;
+        for (size_t i = 0; i < chunk; ++i)
+            pb->data[pb->len + i] = s[i];
+        pb->len += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+static void print_str(t_print_buf *pb, const char *s)
+{
+    size_t n = 0;
+    while (s[n])
+        n++;
+    print_buf_write(pb, s, n);
+}
+
+static void print_int(t_print_buf *pb, int n)
 {
     char buf[12];
     int i = 10, neg = 0;
     buf[11] = '\0';
     if (n == 0)
     {
-        write(1, "0", 1);
+        print_buf_write(pb, "0", 1);
         return;
     }
     if (n < 0)
@@ -40,10 +85,10 @@ static void print_int(int n)
     }
     if (neg)
         buf[i--] = '-';
-    print_str(&buf[i + 1]);
+    print_str(pb, &buf[i + 1]);
 }
 
-static void print_ptr(void *p)
+static void print_ptr(t_print_buf *pb, void *p)
 {
     uintptr_t addr = (uintptr_t)p;
     char buf[19];
@@ -52,7 +97,7 @@ static void print_ptr(void *p)
     buf[18] = '\0';
     if (addr == 0)
     {
-        write(1, "(nil)", 5);
+        print_buf_write(pb, "(nil)", 5);
         return;
     }
     while (addr && i > 1)
@@ -62,17 +107,17 @@ static void print_ptr(void *p)
     }
     buf[i--] = 'x';
     buf[i--] = '0';
-    print_str(&buf[i + 1]);
+    print_str(pb, &buf[i + 1]);
 }
 
-static void print_size_t(size_t n)
+static void print_size_t(t_print_buf *pb, size_t n)
 {
     char buf[21];
     int i = 19;
     buf[20] = '\0';
     if (n == 0)
     {
-        write(1, "0", 1);
+        print_buf_write(pb, "0", 1);
         return;
     }
     while (n && i)
@@ -80,13 +125,11 @@ static void print_size_t(size_t n)
         buf[i--] = '0' + (n % 10);
         n /= 10;
     }
-    print_str(&buf[i + 1]);
+    print_str(pb, &buf[i + 1]);
 }
 
-void print(const char *fmt, ...)
+static void print_va(t_print_buf *pb, const char *fmt, va_list args)
 {
-    va_list args;
-    va_start(args, fmt);
     while (*fmt)
     {
         if (*fmt == '%' && *(fmt + 1))
@@ -95,29 +138,61 @@ void print(const char *fmt, ...)
             if (*fmt == 'd')
             {
                 int n = va_arg(args, int);
-                print_int(n);
+                print_int(pb, n);
             }
             else if (*fmt == 's')
             {
                 char *s = va_arg(args, char *);
-                print_str(s ? s : "(null)");
+                print_str(pb, s ? s : "(null)");
             }
             else if (*fmt == 'p')
             {
                 void *p = va_arg(args, void *);
-                print_ptr(p);
+                print_ptr(pb, p);
             }
             else if (*fmt == 'u')
             {
                 size_t n = va_arg(args, size_t);
-                print_size_t(n);
+                print_size_t(pb, n);
             }
             else
-                write(1, fmt, 1);
+                print_buf_write(pb, fmt, 1);
         }
         else
-            write(1, fmt, 1);
+            print_buf_write(pb, fmt, 1);
         fmt++;
     }
+}
+
+void print_buf(t_print_buf *pb, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    print_va(pb, fmt, args);
+    va_end(args);
+}
+
+// Unbuffered entry points: format into a small stack buffer, one write per call.
+void print(const char *fmt, ...)
+{
+    char data[256];
+    t_print_buf pb;
+    va_list args;
+    print_buf_init(&pb, 1, data, sizeof(data));
+    va_start(args, fmt);
+    print_va(&pb, fmt, args);
     va_end(args);
-}
\ No newline at end of file
+    print_buf_flush(&pb);
+}
+
+void print_fd(int fd, const char *fmt, ...)
+{
+    char data[256];
+    t_print_buf pb;
+    va_list args;
+    print_buf_init(&pb, fd, data, sizeof(data));
+    va_start(args, fmt);
+    print_va(&pb, fmt, args);
+    va_end(args);
+    print_buf_flush(&pb);
+}
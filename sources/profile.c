@@ -0,0 +1,270 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   profile.c                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:21:36 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 14:21:36 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_malloc.h"
+#include "malloc_profile.h"
+#include "print.h"
+
+#ifdef MALLOC_PROFILE
+
+#include <execinfo.h>
+#include <fcntl.h>
+
+typedef struct s_profile_sample
+{
+	void *ptr;	  // payload address; NULL marks an empty slot
+	size_t size;  // requested bytes
+	size_t depth; // valid frames in stack
+	void *stack[MALLOC_PROFILE_DEPTH];
+} t_profile_sample;
+
+// Sample table (open addressing, linear probing). Guarded by the allocator mutex.
+static struct s_profile_state
+{
+	t_profile_sample *table; // MALLOC_PROFILE_SLOTS entries, mmap'd on first sample
+	size_t live;
+	size_t dropped; // samples lost because the table was full
+	size_t period;
+} g_profile = {NULL, 0, 0, MALLOC_PROFILE_PERIOD};
+
+#define PROFILE_TLS __thread __attribute__((tls_model("initial-exec")))
+
+static PROFILE_TLS int64_t t_bytes_left; // bytes until this thread's next sample
+static PROFILE_TLS uint64_t t_rng;
+static PROFILE_TLS int t_in_profiler; // backtrace() may allocate: never sample those
+
+// log2(x) for x in (0, 1]: exponent plus a quadratic fit of the mantissa (|err| < 0.01).
+static double profile_log2(double x)
+{
+	union u_bits
+	{
+		double d;
+		uint64_t u;
+	} v = {.d = x};
+	int e = (int)((v.u >> 52) & 0x7ff) - 1023;
+	v.u = (v.u & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+	double m = v.d;
+	return e + (-0.34484843 * m + 2.02466578) * m - 1.67487759;
+}
+
+// Exponentially distributed gap with mean `period`: -ln(U) * period.
+static int64_t profile_next_gap(size_t period)
+{
+	if (!t_rng)
+		t_rng = ((uint64_t)(uintptr_t)&t_rng * 0x9e3779b97f4a7c15ULL) | 1;
+	t_rng ^= t_rng << 13;
+	t_rng ^= t_rng >> 7;
+	t_rng ^= t_rng << 17;
+	double u = (double)((t_rng >> 11) + 1) / 9007199254740992.0; // (0, 1]
+	double gap = -profile_log2(u) * 0.6931471805599453 * (double)period;
+	return (int64_t)gap + 1;
+}
+
+static size_t profile_slot(void *ptr)
+{
+	return (size_t)(((uintptr_t)ptr >> 4) * 0x9e3779b97f4a7c15ULL >> 40) & (MALLOC_PROFILE_SLOTS - 1);
+}
+
+static void profile_insert(void *ptr, size_t size, void **stack, size_t depth)
+{
+	if (!g_profile.table)
+	{
+		void *mem = mmap(NULL, MALLOC_PROFILE_SLOTS * sizeof(t_profile_sample), PROT_READ | PROT_WRITE,
+						 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED)
+			return;
+		g_profile.table = (t_profile_sample *)mem;
+	}
+	if (g_profile.live >= MALLOC_PROFILE_SLOTS * 3 / 4)
+	{
+		g_profile.dropped++;
+		return;
+	}
+	size_t i = profile_slot(ptr);
+	while (g_profile.table[i].ptr)
+		i = (i + 1) & (MALLOC_PROFILE_SLOTS - 1);
+	t_profile_sample *s = &g_profile.table[i];
+	s->ptr = ptr;
+	s->size = size;
+	s->depth = depth;
+	for (size_t k = 0; k < depth; ++k)
+		s->stack[k] = stack[k];
+	g_profile.live++;
+	ptr_to_block(ptr)->flags |= BLOCK_F_SAMPLED;
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones.
+static void profile_remove(void *ptr)
+{
+	if (!g_profile.table)
+		return;
+	size_t mask = MALLOC_PROFILE_SLOTS - 1;
+	size_t i = profile_slot(ptr);
+	while (g_profile.table[i].ptr && g_profile.table[i].ptr != ptr)
+		i = (i + 1) & mask;
+	if (!g_profile.table[i].ptr)
+		return;
+	size_t j = i;
+	while (1)
+	{
+		j = (j + 1) & mask;
+		if (!g_profile.table[j].ptr)
+			break;
+		size_t home = profile_slot(g_profile.table[j].ptr);
+		// Move j into the hole at i unless its home lies cyclically in (i, j].
+		if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j)))
+		{
+			g_profile.table[i] = g_profile.table[j];
+			i = j;
+		}
+	}
+	g_profile.table[i].ptr = NULL;
+	g_profile.live--;
+}
+
+void malloc_profile_account(void *ptr, size_t size)
+{
+	if (t_in_profiler)
+		return;
+	t_bytes_left -= (int64_t)(size ? size : 1);
+	if (t_bytes_left > 0)
+		return;
+	size_t period = __atomic_load_n(&g_profile.period, __ATOMIC_RELAXED);
+	if (!period)
+	{
+		t_bytes_left = INT64_MAX;
+		return;
+	}
+	int first = (t_bytes_left == -(int64_t)(size ? size : 1)); // counter was never armed
+	t_bytes_left = profile_next_gap(period);
+	if (first)
+		return;
+	// Capture outside the sample table update; skip this frame and malloc().
+	void *frames[MALLOC_PROFILE_DEPTH + 2];
+	t_in_profiler = 1;
+	int n = backtrace(frames, MALLOC_PROFILE_DEPTH + 2);
+	t_in_profiler = 0;
+	size_t depth = n > 2 ? (size_t)n - 2 : 0;
+	malloc_lock();
+	profile_insert(ptr, size, frames + 2, depth);
+	malloc_unlock();
+}
+
+void malloc_profile_forget(void *ptr)
+{
+	malloc_lock();
+	t_block *b = ptr_to_block(ptr);
+	if (b->flags & BLOCK_F_SAMPLED)
+	{
+		profile_remove(ptr);
+		b->flags &= (unsigned char)~BLOCK_F_SAMPLED;
+	}
+	malloc_unlock();
+}
+
+void malloc_profile_set_period(size_t bytes)
+{
+	__atomic_store_n(&g_profile.period, bytes, __ATOMIC_RELAXED);
+	t_bytes_left = 0; // re-arm the calling thread with the new mean
+}
+
+// Resolve backtrace()'s lazy libgcc loading at startup rather than in the
+// middle of a sampled malloc (it allocates, and may take the loader lock).
+__attribute__((constructor)) static void profile_warmup(void)
+{
+	void *frame[1];
+	t_in_profiler = 1;
+	backtrace(frame, 1);
+	t_in_profiler = 0;
+}
+
+static void profile_copy_maps(int fd)
+{
+	char buf[4096];
+	int in = open("/proc/self/maps", O_RDONLY);
+	if (in < 0)
+		return;
+	ssize_t n;
+	while ((n = read(in, buf, sizeof(buf))) > 0)
+		if (write(fd, buf, (size_t)n) != n)
+			break;
+	close(in);
+}
+
+int malloc_profile_dump(const char *path)
+{
+	if (!path)
+		return -1;
+	// Snapshot the live samples under the lock, write them without it (as show.c does).
+	malloc_lock();
+	size_t count = g_profile.live;
+	size_t period = g_profile.period;
+	t_profile_sample *snap = NULL;
+	size_t bytes = count * sizeof(t_profile_sample);
+	if (count)
+	{
+		snap = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (snap == MAP_FAILED)
+		{
+			malloc_unlock();
+			return -1;
+		}
+		size_t k = 0;
+		for (size_t i = 0; i < MALLOC_PROFILE_SLOTS && k < count; ++i)
+			if (g_profile.table[i].ptr)
+				snap[k++] = g_profile.table[i];
+	}
+	malloc_unlock();
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		if (snap)
+			munmap(snap, bytes);
+		return -1;
+	}
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++i)
+		total += snap[i].size;
+	char data[4096];
+	t_print_buf pb;
+	print_buf_init(&pb, fd, data, sizeof(data));
+	print_buf(&pb, "heap profile: %u: %u [ %u: %u] @ heap_v2/%u\n", count, total, count, total, period);
+	for (size_t i = 0; i < count; ++i)
+	{
+		print_buf(&pb, "1: %u [1: %u] @", snap[i].size, snap[i].size);
+		for (size_t k = 0; k < snap[i].depth; ++k)
+			print_buf(&pb, " %p", snap[i].stack[k]);
+		print_buf(&pb, "\n");
+	}
+	print_buf(&pb, "\nMAPPED_LIBRARIES:\n");
+	print_buf_flush(&pb);
+	profile_copy_maps(fd);
+	close(fd);
+	if (snap)
+		munmap(snap, bytes);
+	return 0;
+}
+
+#else
+
+int malloc_profile_dump(const char *path)
+{
+	(void)path;
+	return -1;
+}
+
+void malloc_profile_set_period(size_t bytes)
+{
+	(void)bytes;
+}
+
+#endif
@@ -26,7 +26,7 @@ static void *ft_memcpy(void *dst, const void *src, size_t n)
 	return (dst);
 }
 
-void *realloc(void *ptr, size_t size)
+static void *realloc_body(void *ptr, size_t size)
 {
 	malloc_lock();
 	if (!ptr)
@@ -59,4 +59,14 @@ void *realloc(void *ptr, size_t size)
 	free(ptr);
 	malloc_unlock();
 	return n;
-}
\ No newline at end of file
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	// The inner malloc()/free() calls are part of this realloc, not new events.
+	MALLOC_TRACE_ENTER();
+	void *n = realloc_body(ptr, size);
+	MALLOC_TRACE_LEAVE();
+	MALLOC_TRACE_EVENT(MALLOC_TRACE_REALLOC, ptr, size, n);
+	return n;
+}
@@ -0,0 +1,100 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   reserve.c                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 21:07:14 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 14:20:06 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_malloc.h"
+#include "malloc_reserve.h"
+
+#ifndef MAP_NORESERVE
+# define MAP_NORESERVE 0
+#endif
+
+t_reserve g_reserve = {NULL, NULL, NULL};
+static int g_reserve_failed; // do not retry a reservation the kernel refused
+
+#ifdef MALLOC_HUGEPAGE
+// Over-map by one huge page and trim both ends to a 2 MiB aligned range.
+static void *map_aligned(size_t bytes, int prot, int flags)
+{
+	char *p = mmap(NULL, bytes + MALLOC_HUGE_PAGE, prot, flags, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	char *a = (char *)ALIGN_UP((uintptr_t)p, MALLOC_HUGE_PAGE);
+	if (a > p)
+		munmap(p, (size_t)(a - p));
+	size_t tail = (size_t)(p + bytes + MALLOC_HUGE_PAGE - (a + bytes));
+	if (tail)
+		munmap(a + bytes, tail);
+# ifdef MADV_HUGEPAGE
+	madvise(a, bytes, MADV_HUGEPAGE); // advisory: THP disabled just keeps small pages
+# endif
+	return a;
+}
+#endif
+
+void *malloc_map(size_t bytes)
+{
+#ifdef MALLOC_HUGEPAGE
+	if (bytes % MALLOC_HUGE_PAGE == 0)
+	{
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+# ifdef MAP_HUGETLB
+		// Needs a preallocated hugetlb pool (vm.nr_hugepages); usually empty.
+		void *h = mmap(NULL, bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+		if (h != MAP_FAILED)
+			return h;
+# endif
+		return map_aligned(bytes, PROT_READ | PROT_WRITE, flags);
+	}
+#endif
+	return malloc_map_small(bytes);
+}
+
+void *malloc_map_small(size_t bytes)
+{
+	void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return p == MAP_FAILED ? NULL : p;
+}
+
+// Halve the request until the address space limit (RLIMIT_AS, 32-bit hosts,
+// strict overcommit) accepts it.
+static int reserve_init(void)
+{
+	for (size_t size = MALLOC_RESERVE_SIZE; size >= MALLOC_RESERVE_MIN; size /= 2)
+	{
+#ifdef MALLOC_HUGEPAGE
+		void *p = map_aligned(size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE);
+#else
+		void *p = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		p = p == MAP_FAILED ? NULL : p;
+#endif
+		if (p)
+		{
+			g_reserve = (t_reserve){(char *)p, (char *)p, (char *)p + size};
+			return 0;
+		}
+	}
+	g_reserve_failed = 1;
+	return -1;
+}
+
+void *malloc_reserve_commit(size_t bytes)
+{
+	if (!g_reserve.base && (g_reserve_failed || reserve_init() != 0))
+		return NULL;
+	if (bytes > (size_t)(g_reserve.end - g_reserve.top))
+		return NULL;
+	if (mprotect(g_reserve.top, bytes, PROT_READ | PROT_WRITE) != 0)
+		return NULL;
+	void *p = g_reserve.top;
+	g_reserve.top += bytes;
+	return p;
+}
@@ -6,12 +6,13 @@
 /*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2025/09/18 14:08:43 by tamigore          #+#    #+#             */
-/*   Updated: 2025/09/27 15:42:40 by tamigore         ###   ########.fr       */
+/*   Updated: 2026/10/20 10:04:12 by tamigore         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
 #include "ft_malloc.h"
 #include "print.h"
+#include "malloc_show.h"
 
 #include <sys/mman.h>
 #ifndef MAP_ANONYMOUS
@@ -20,19 +21,33 @@
 #endif
 #endif
 
+#define SHOW_BUF_SIZE (64UL * 1024) // output buffer, mapped per call
+
 // ---------------- Snapshot Structures ----------------
 typedef struct s_range
 {
 	void *start;
 	void *end;
 	size_t size;
+	size_t requested;	 // 0 for free blocks
+	size_t zone;		 // index in the snapshot's zones
+	unsigned char flags; // SHOW_BLOCK_*
 } t_range;
 
+typedef struct s_zone_snap
+{
+	t_zone *zone; // address only: not dereferenced after unlock
+	char *base;	  // zone_base(): the mapping of a LARGE zone
+	size_t capacity;
+	size_t used;
+	size_t blocks; // ranges copied for this zone
+} t_zone_snap;
+
 typedef struct s_type_snapshot
 {
 	const char *label;
 	t_zone_type type;
-	t_zone **zones; // zone pointer array (addresses at snapshot time)
+	t_zone_snap *zones; // zones by ascending address
 	size_t zone_count;
 	t_range *allocs; // allocated (in-use) block payload ranges
 	size_t alloc_count;
@@ -44,33 +59,33 @@ typedef struct s_type_snapshot
 
 // ---------------- Local helpers (no allocation after unlock) ----------------
 
-static void insertion_sort_ptrs(t_zone **arr, size_t n)
+// In-place heap sort by address: O(n log n) and no allocation while the lock is held.
+static void sift_down_zones(t_zone_snap *arr, size_t root, size_t n)
 {
-	for (size_t i = 1; i < n; ++i)
+	while (2 * root + 1 < n)
 	{
-		t_zone *key = arr[i];
-		size_t j = i;
-		while (j > 0 && arr[j - 1] > key)
-		{
-			arr[j] = arr[j - 1];
-			--j;
-		}
-		arr[j] = key;
+		size_t child = 2 * root + 1;
+		if (child + 1 < n && arr[child].base < arr[child + 1].base)
+			child++;
+		if (arr[root].base >= arr[child].base)
+			return;
+		t_zone_snap tmp = arr[root];
+		arr[root] = arr[child];
+		arr[child] = tmp;
+		root = child;
 	}
 }
 
-static void insertion_sort_ranges(t_range *arr, size_t n)
+static void heap_sort_zones(t_zone_snap *arr, size_t n)
 {
-	for (size_t i = 1; i < n; ++i)
+	for (size_t i = n / 2; i-- > 0;)
+		sift_down_zones(arr, i, n);
+	for (size_t end = n; end-- > 1;)
 	{
-		t_range key = arr[i];
-		size_t j = i;
-		while (j > 0 && arr[j - 1].start > key.start)
-		{
-			arr[j] = arr[j - 1];
-			--j;
-		}
-		arr[j] = key;
+		t_zone_snap tmp = arr[0];
+		arr[0] = arr[end];
+		arr[end] = tmp;
+		sift_down_zones(arr, 0, end);
 	}
 }
 
@@ -98,7 +113,7 @@ static void free_snapshot_arrays(t_type_snapshot *s)
 	if (!s)
 		return;
 	if (s->zones)
-		munmap(s->zones, s->zone_count * sizeof(t_zone *));
+		munmap(s->zones, s->zone_count * sizeof(t_zone_snap));
 	if (s->allocs)
 		munmap(s->allocs, s->alloc_count * sizeof(t_range));
 	if (s->frees)
@@ -108,7 +123,8 @@ static void free_snapshot_arrays(t_type_snapshot *s)
 }
 
 // Collect snapshot for a given type while allocator lock is held.
-static void snapshot_type(t_type_snapshot *out, t_zone_type type, const char *label, int want_free)
+// Returns -1 when a snapshot array could not be mapped.
+static int snapshot_type(t_type_snapshot *out, t_zone_type type, const char *label, int want_free)
 {
 	*out = (t_type_snapshot){.label = label, .type = type};
 	// Count zones
@@ -117,28 +133,35 @@ static void snapshot_type(t_type_snapshot *out, t_zone_type type, const char *la
 		if (z->type == type)
 			zc++;
 	if (!zc)
-		return; // leave empty snapshot
-	out->zones = (t_zone **)snap_alloc(zc * sizeof(t_zone *));
+		return 0; // leave empty snapshot
+	out->zones = (t_zone_snap *)snap_alloc(zc * sizeof(t_zone_snap));
 	if (!out->zones)
-		return; // allocation failure => skip snapshot
-	// Fill zone pointer array
-	size_t zi = 0;
+		return -1; // allocation failure => skip snapshot
+	// Fill zone array back to front: zones are pushed at the list head and
+	// TINY/SMALL zones are carved upwards from the reservation, so they come
+	// out sorted. Only LARGE and fallback mmap zones need the sort.
+	size_t zi = zc;
+	int sorted = 1;
 	for (t_zone *z = g_zones; z; z = z->next)
 		if (z->type == type)
-			out->zones[zi++] = z;
+		{
+			out->zones[--zi] = (t_zone_snap){.zone = z, .base = zone_base(z), .capacity = z->capacity, .used = z->used};
+			if (zi + 1 < zc && out->zones[zi].base > out->zones[zi + 1].base)
+				sorted = 0;
+		}
 	out->zone_count = zc;
-	if (zc > 1)
-		insertion_sort_ptrs(out->zones, zc);
+	if (!sorted)
+		heap_sort_zones(out->zones, zc);
 	// First pass: count blocks
 	size_t alloc_cnt = 0, free_cnt = 0;
 	size_t used_sum = 0, cap_sum = 0;
 	for (size_t i = 0; i < zc; ++i)
 	{
-		used_sum += out->zones[i]->used;
-		cap_sum += out->zones[i]->capacity;
-		for (t_block *b = out->zones[i]->blocks; b; b = b->next)
+		used_sum += out->zones[i].used;
+		cap_sum += out->zones[i].capacity;
+		for (t_block *b = out->zones[i].zone->blocks; b; b = b->next)
 		{
-			if (!b->free)
+			if (!block_is_free(b))
 				alloc_cnt++;
 			else if (want_free)
 				free_cnt++;
@@ -151,68 +174,117 @@ static void snapshot_type(t_type_snapshot *out, t_zone_type type, const char *la
 	if (want_free && free_cnt)
 		out->frees = (t_range *)snap_alloc(free_cnt * sizeof(t_range));
 	if ((alloc_cnt && !out->allocs) || (free_cnt && want_free && !out->frees))
-		return; // partial failure; treat as empty (arrays may be NULL)
+	{
+		// partial failure; treat as empty
+		if (out->allocs)
+			munmap(out->allocs, alloc_cnt * sizeof(t_range));
+		if (out->frees)
+			munmap(out->frees, free_cnt * sizeof(t_range));
+		out->allocs = NULL;
+		out->frees = NULL;
+		return -1;
+	}
 	// Second pass: populate ranges
 	size_t ai = 0, fi = 0;
 	for (size_t i = 0; i < zc; ++i)
 	{
-		for (t_block *b = out->zones[i]->blocks; b; b = b->next)
+		for (t_block *b = out->zones[i].zone->blocks; b; b = b->next)
 		{
-			void *start = (char *)b + sizeof(t_block);
-			if (!b->free && out->allocs)
+			void *start = block_payload(b);
+			t_range r = {.start = start, .end = (char *)start + b->size, .size = b->size, .zone = i};
+			if (!block_is_free(b) && out->allocs)
 			{
-				out->allocs[ai].start = start;
-				out->allocs[ai].end = (char *)start + b->size;
-				out->allocs[ai].size = b->size;
-				ai++;
+				r.requested = b->requested;
+				r.flags = (b->flags & BLOCK_F_CACHED) ? SHOW_BLOCK_CACHED : 0;
+				out->allocs[ai++] = r;
+				out->zones[i].blocks++;
 			}
-			else if (want_free && b->free && out->frees)
+			else if (want_free && block_is_free(b) && out->frees)
 			{
-				out->frees[fi].start = start;
-				out->frees[fi].end = (char *)start + b->size;
-				out->frees[fi].size = b->size;
-				fi++;
+				r.flags = SHOW_BLOCK_FREE;
+				out->frees[fi++] = r;
+				out->zones[i].blocks++;
 			}
 		}
 	}
+	// Zones are sorted and each zone's block list is in address order, so the
+	// ranges come out sorted without a second sort.
 	out->alloc_count = alloc_cnt;
 	out->free_count = free_cnt;
-	if (out->allocs && alloc_cnt > 1)
-		insertion_sort_ranges(out->allocs, alloc_cnt);
-	if (out->frees && free_cnt > 1)
-		insertion_sort_ranges(out->frees, free_cnt);
+	return 0;
 }
 
 void ft_print(const char *s)
 {
-	if (s)
-		while (*s)
-			write(1, s++, 1);
+	size_t n = 0;
+	if (!s)
+		return;
+	while (s[n])
+		n++;
+	write(1, s, n);
 }
 
 // Print a snapshot (no allocator lock held) WITHOUT colors.
-static void print_snapshot(const t_type_snapshot *s, int show_stats, int show_free, size_t *ptotal)
+static void print_snapshot(t_print_buf *pb, const t_type_snapshot *s, int show_stats, int show_free, size_t *ptotal)
 {
 	if (!s || !s->zone_count)
 		return;
-	print("%s : %p\n", s->label, (void *)s->zones[0]);
+	print_buf(pb, "%s : %p\n", s->label, (void *)s->zones[0].base);
 	if (show_stats)
 	{
 		size_t free_bytes = (s->capacity_sum >= s->used_sum) ? (s->capacity_sum - s->used_sum) : 0;
-		print("# stats: zones=%u used=%u capacity=%u free=%u\n", s->zone_count, s->used_sum, s->capacity_sum, free_bytes);
+		print_buf(pb, "# stats: zones=%u used=%u capacity=%u free=%u\n", s->zone_count, s->used_sum, s->capacity_sum, free_bytes);
 	}
 	for (size_t i = 0; i < s->alloc_count && s->allocs; ++i)
 	{
-		print("%p - %p : %u bytes\n", s->allocs[i].start, s->allocs[i].end, s->allocs[i].size);
+		print_buf(pb, "%p - %p : %u bytes\n", s->allocs[i].start, s->allocs[i].end, s->allocs[i].size);
 		*ptotal += s->allocs[i].size;
 	}
 	if (show_free && s->frees)
 	{
 		for (size_t i = 0; i < s->free_count; ++i)
-			print("FREE %p - %p : %u bytes\n", s->frees[i].start, s->frees[i].end, s->frees[i].size);
+			print_buf(pb, "FREE %p - %p : %u bytes\n", s->frees[i].start, s->frees[i].end, s->frees[i].size);
 	}
 }
 
+#ifdef MALLOC_LOCK_STATS
+static void print_lock_hist(t_print_buf *pb, const char *label, const uint64_t *hist)
+{
+	print_buf(pb, "  %s:", label);
+	for (size_t k = 0; k < MALLOC_LOCK_HIST_BUCKETS; ++k)
+		if (hist[k])
+			print_buf(pb, " 2^%u=%u", k, (size_t)hist[k]);
+	print_buf(pb, "\n");
+}
+
+// Extended report: one section per instrumented lock (LOCKSTAT=1 builds).
+static void print_lock_stats(t_print_buf *pb)
+{
+	t_malloc_lock_stats stats[4];
+	size_t n = malloc_lock_stats(stats, sizeof(stats) / sizeof(stats[0]));
+	for (size_t i = 0; i < n && i < sizeof(stats) / sizeof(stats[0]); ++i)
+	{
+		const t_malloc_lock_stats *s = &stats[i];
+		print_buf(pb, "LOCK %s : acquisitions=%u contended=%u wait=%u cycles hold=%u cycles\n", s->name,
+			  (size_t)s->acquisitions, (size_t)s->contended, (size_t)s->wait_cycles, (size_t)s->hold_cycles);
+		print_lock_hist(pb, "wait", s->wait_hist);
+		print_lock_hist(pb, "hold", s->hold_hist);
+	}
+}
+#endif
+
+// Buffered output: large write() calls instead of one per character. Falls
+// back to the caller's small buffer when the mapping fails.
+static char *open_output(t_print_buf *pb, int fd, char *small, size_t small_size)
+{
+	char *data = (char *)snap_alloc(SHOW_BUF_SIZE);
+	if (data)
+		print_buf_init(pb, fd, data, SHOW_BUF_SIZE);
+	else
+		print_buf_init(pb, fd, small, small_size);
+	return data;
+}
+
 void show_alloc_mem()
 {
 	// Environment variables removed; always minimal mandatory output
@@ -226,13 +298,130 @@ void show_alloc_mem()
 	snapshot_type(&snaps[2], ZONE_LARGE, "LARGE", show_free);
 	malloc_unlock();
 
+	char small[256];
+	t_print_buf out;
+	t_print_buf *pb = &out;
+	char *data = open_output(pb, 1, small, sizeof(small));
+
 	size_t total = 0;
-	print_snapshot(&snaps[0], show_stats, show_free, &total);
-	print_snapshot(&snaps[1], show_stats, show_free, &total);
-	print_snapshot(&snaps[2], show_stats, show_free, &total);
-	print("Total : %u bytes\n", total);
+	print_snapshot(pb, &snaps[0], show_stats, show_free, &total);
+	print_snapshot(pb, &snaps[1], show_stats, show_free, &total);
+	print_snapshot(pb, &snaps[2], show_stats, show_free, &total);
+	print_buf(pb, "Total : %u bytes\n", total);
+#ifdef MALLOC_LOCK_STATS
+	print_lock_stats(pb);
+#endif
+	print_buf_flush(pb);
+	if (data)
+		munmap(data, SHOW_BUF_SIZE);
 
 	free_snapshot_arrays(&snaps[0]);
 	free_snapshot_arrays(&snaps[1]);
 	free_snapshot_arrays(&snaps[2]);
-}
\ No newline at end of file
+}
+
+// ---------------- show_alloc_mem_ex ----------------
+
+// Next range of zone `zi` in address order: allocs and frees are each sorted,
+// so this merges the two lists.
+static const t_range *next_range(const t_type_snapshot *s, size_t *ai, size_t *fi, size_t zi)
+{
+	const t_range *a = (*ai < s->alloc_count && s->allocs[*ai].zone == zi) ? &s->allocs[*ai] : NULL;
+	const t_range *f = (*fi < s->free_count && s->frees[*fi].zone == zi) ? &s->frees[*fi] : NULL;
+	if (a && (!f || a->start < f->start))
+	{
+		(*ai)++;
+		return a;
+	}
+	if (f)
+		(*fi)++;
+	return f;
+}
+
+static void write_json(t_print_buf *pb, const t_type_snapshot *snaps)
+{
+	int first_zone = 1;
+	print_buf(pb, "{\"version\":%d,\"zones\":[", SHOW_BIN_VERSION);
+	for (int t = 0; t < 3; ++t)
+	{
+		const t_type_snapshot *s = &snaps[t];
+		size_t ai = 0, fi = 0;
+		for (size_t zi = 0; zi < s->zone_count; ++zi)
+		{
+			const t_zone_snap *z = &s->zones[zi];
+			print_buf(pb, "%s\n{\"type\":\"%s\",\"address\":\"%p\",\"capacity\":%u,\"used\":%u,\"blocks\":[",
+					  first_zone ? "" : ",", s->label, (void *)z->base, z->capacity, z->used);
+			first_zone = 0;
+			const t_range *r;
+			for (int first = 1; (r = next_range(s, &ai, &fi, zi)); first = 0)
+				print_buf(pb, "%s\n{\"address\":\"%p\",\"size\":%u,\"requested\":%u,\"free\":%s,\"cached\":%s}",
+						  first ? "" : ",", r->start, r->size, r->requested,
+						  (r->flags & SHOW_BLOCK_FREE) ? "true" : "false",
+						  (r->flags & SHOW_BLOCK_CACHED) ? "true" : "false");
+			print_buf(pb, "]}");
+		}
+	}
+	print_buf(pb, "\n]}\n");
+}
+
+static void write_binary(t_print_buf *pb, const t_type_snapshot *snaps)
+{
+	t_show_bin_header h = {.magic = SHOW_BIN_MAGIC, .version = SHOW_BIN_VERSION};
+	for (int t = 0; t < 3; ++t)
+	{
+		h.zone_count += snaps[t].zone_count;
+		h.block_count += snaps[t].alloc_count + snaps[t].free_count;
+	}
+	print_buf_write(pb, &h, sizeof(h));
+	for (int t = 0; t < 3; ++t)
+	{
+		const t_type_snapshot *s = &snaps[t];
+		size_t ai = 0, fi = 0;
+		for (size_t zi = 0; zi < s->zone_count; ++zi)
+		{
+			const t_zone_snap *z = &s->zones[zi];
+			t_show_bin_zone zr = {.address = (uintptr_t)z->base, .capacity = z->capacity, .used = z->used,
+								  .type = (uint32_t)s->type, .block_count = (uint32_t)z->blocks};
+			print_buf_write(pb, &zr, sizeof(zr));
+			const t_range *r;
+			while ((r = next_range(s, &ai, &fi, zi)))
+			{
+				t_show_bin_block br = {.address = (uintptr_t)r->start, .size = r->size,
+									   .requested = r->requested, .flags = r->flags};
+				print_buf_write(pb, &br, sizeof(br));
+			}
+		}
+	}
+}
+
+int show_alloc_mem_ex(int fd, t_show_format format)
+{
+	if (format != SHOW_FORMAT_JSON && format != SHOW_FORMAT_BINARY)
+		return -1;
+	malloc_lock();
+	t_type_snapshot snaps[3];
+	int err = snapshot_type(&snaps[0], ZONE_TINY, "TINY", 1);
+	err |= snapshot_type(&snaps[1], ZONE_SMALL, "SMALL", 1);
+	err |= snapshot_type(&snaps[2], ZONE_LARGE, "LARGE", 1);
+	malloc_unlock();
+
+	if (!err)
+	{
+		char small[256];
+		t_print_buf pb;
+		char *data = open_output(&pb, fd, small, sizeof(small));
+		if (format == SHOW_FORMAT_JSON)
+			write_json(&pb, snaps);
+		else
+			write_binary(&pb, snaps);
+		print_buf_flush(&pb);
+		err = pb.error ? -1 : 0;
+		if (data)
+			munmap(data, SHOW_BUF_SIZE);
+	}
+
+	free_snapshot_arrays(&snaps[0]);
+	free_snapshot_arrays(&snaps[1]);
+	free_snapshot_arrays(&snaps[2]);
+	return err ? -1 : 0;
+}
@@ -0,0 +1,247 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   stats.c                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 13:05:48 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 10:04:12 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_malloc.h"
+#include "malloc_stats.h"
+#include "malloc_percpu.h"
+#include "malloc_sizemap.h"
+#include "print.h"
+
+#ifdef MALLOC_STATS
+// Arena counters: only written with the allocator mutex held.
+static struct s_malloc_arena_stats
+{
+	t_malloc_class_stats types[3];
+	t_malloc_class_stats classes[MALLOC_STATS_CLASSES];
+} g_arena_stats;
+
+size_t malloc_stats_class(size_t size)
+{
+	return size > SMALL_MAX ? MALLOC_STATS_CLASSES - 1 : malloc_class_lookup(size);
+}
+
+static t_zone_type block_type(const t_block *b)
+{
+	return b->zone ? b->zone->type : ZONE_LARGE;
+}
+
+void malloc_stats_count_alloc(const t_block *b, t_malloc_alloc_path path)
+{
+	t_malloc_class_stats *c[2] = {&g_arena_stats.types[block_type(b)],
+								  &g_arena_stats.classes[malloc_stats_class(b->size)]};
+	for (int i = 0; i < 2; ++i)
+	{
+		c[i]->allocs++;
+		c[i]->alloc_bytes += b->size;
+		if (path == MALLOC_PATH_BIN)
+			c[i]->bin_hits++;
+		else if (path == MALLOC_PATH_APPEND)
+			c[i]->append_allocs++;
+		else
+			c[i]->zone_allocs++;
+	}
+}
+
+void malloc_stats_count_free(const t_block *b)
+{
+	t_malloc_class_stats *c[2] = {&g_arena_stats.types[block_type(b)],
+								  &g_arena_stats.classes[malloc_stats_class(b->size)]};
+	for (int i = 0; i < 2; ++i)
+	{
+		c[i]->frees++;
+		c[i]->free_bytes += b->size;
+	}
+}
+
+void malloc_stats_count_split(const t_block *b)
+{
+	g_arena_stats.types[block_type(b)].splits++;
+	g_arena_stats.classes[malloc_stats_class(b->size)].splits++;
+}
+
+void malloc_stats_count_coalesce(const t_block *b)
+{
+	g_arena_stats.types[block_type(b)].coalesces++;
+	g_arena_stats.classes[malloc_stats_class(b->size)].coalesces++;
+}
+
+static void add_counters(t_malloc_class_stats *dst, const t_malloc_class_stats *src)
+{
+	dst->allocs += src->allocs;
+	dst->frees += src->frees;
+	dst->alloc_bytes += src->alloc_bytes;
+	dst->free_bytes += src->free_bytes;
+	dst->bin_hits += src->bin_hits;
+	dst->append_allocs += src->append_allocs;
+	dst->zone_allocs += src->zone_allocs;
+	dst->cache_hits += src->cache_hits;
+	dst->splits += src->splits;
+	dst->coalesces += src->coalesces;
+}
+#endif
+
+// Resident bytes of the whole pages inside [start, start + len).
+static size_t resident_bytes(char *start, size_t len)
+{
+	size_t ps = malloc_pagesize();
+	uintptr_t lo = ALIGN_UP((uintptr_t)start, ps);
+	uintptr_t hi = ((uintptr_t)start + len) & ~(uintptr_t)(ps - 1);
+	size_t total = 0;
+	unsigned char vec[256];
+	while (lo < hi)
+	{
+		size_t pages = (hi - lo) / ps;
+		if (pages > sizeof(vec))
+			pages = sizeof(vec);
+		if (mincore((void *)lo, pages * ps, vec) != 0)
+			return total;
+		for (size_t i = 0; i < pages; ++i)
+			if (vec[i] & 1)
+				total += ps;
+		lo += pages * ps;
+	}
+	return total;
+}
+
+// A page range to probe with mincore once the allocator mutex is released.
+typedef struct s_stats_range
+{
+	char *start;
+	size_t len;
+	int dirty;
+} t_stats_range;
+
+static void stats_add_range(t_stats_range *r, size_t max, size_t *n, char *start, size_t len, int dirty)
+{
+	if (len < malloc_pagesize()) // cannot hold a whole page
+		return;
+	if (*n < max)
+		r[*n] = (t_stats_range){start, len, dirty};
+	++*n;
+}
+
+// Zone figures and the ranges behind resident/dirty (allocator mutex held).
+// Returns the number of ranges needed, which may exceed max: nothing past
+// max is written.
+static size_t stats_collect_ranges(t_malloc_stats *out, t_stats_range *r, size_t max)
+{
+	size_t n = 0;
+	for (int t = 0; t < 3; ++t)
+		out->zones[t] = 0;
+	out->mapped = 0;
+	for (t_zone *z = g_zones; z; z = z->next)
+	{
+		size_t map_size = z->data_offset + z->capacity;
+		out->zones[z->type]++;
+		out->mapped += map_size;
+		stats_add_range(r, max, &n, zone_base(z), map_size, 0);
+		char *data_end = zone_base(z) + map_size;
+		char *tail_end = zone_base(z) + z->data_offset;
+		for (t_block *b = z->blocks; b; b = b->next)
+		{
+			char *payload = block_payload(b);
+			if (block_is_free(b))
+				stats_add_range(r, max, &n, payload, b->size, 1);
+			tail_end = payload + b->size;
+		}
+		stats_add_range(r, max, &n, tail_end, (size_t)(data_end - tail_end), 1);
+	}
+	return n;
+}
+
+int malloc_stats_get(t_malloc_stats *out)
+{
+	if (!out)
+		return -1;
+	*out = (t_malloc_stats){0};
+	t_stats_range stack[64], *ranges = stack;
+	size_t cap = sizeof(stack) / sizeof(*stack), n;
+	for (;;)
+	{
+		malloc_lock();
+		n = stats_collect_ranges(out, ranges, cap);
+		if (n <= cap)
+			break;
+		malloc_unlock();
+		if (ranges != stack)
+			munmap(ranges, cap * sizeof(*ranges));
+		cap = ALIGN_UP(2 * n * sizeof(*ranges), malloc_pagesize()) / sizeof(*ranges);
+		ranges = mmap(NULL, cap * sizeof(*ranges), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ranges == MAP_FAILED)
+			return -1;
+	}
+#ifdef MALLOC_STATS
+	for (int t = 0; t < 3; ++t)
+		add_counters(&out->types[t], &g_arena_stats.types[t]);
+	for (size_t i = 0; i < MALLOC_STATS_CLASSES; ++i)
+		add_counters(&out->classes[i], &g_arena_stats.classes[i]);
+#endif
+	malloc_unlock();
+	// mincore runs unlocked; a range released in the meantime reads as not resident.
+	for (size_t i = 0; i < n; ++i)
+		*(ranges[i].dirty ? &out->dirty : &out->resident) += resident_bytes(ranges[i].start, ranges[i].len);
+	if (ranges != stack)
+		munmap(ranges, cap * sizeof(*ranges));
+#if defined(MALLOC_STATS) && defined(MALLOC_PERCPU)
+	uint64_t hits[PERCPU_CLASSES], returns[PERCPU_CLASSES];
+	malloc_percpu_stats(hits, returns);
+	for (size_t i = 0; i < PERCPU_CLASSES; ++i)
+	{
+		size_t size = malloc_class_size(i);
+		t_malloc_class_stats fast = {.allocs = hits[i], .frees = returns[i], .alloc_bytes = hits[i] * size,
+									 .free_bytes = returns[i] * size, .cache_hits = hits[i]};
+		add_counters(&out->classes[malloc_stats_class(size)], &fast);
+		add_counters(&out->types[size <= TINY_MAX ? ZONE_TINY : ZONE_SMALL], &fast);
+	}
+#endif
+	for (size_t i = 0; i < MALLOC_STATS_CLASSES; ++i)
+		out->classes[i].size = (i + 1 < MALLOC_STATS_CLASSES) ? malloc_class_size(i) : 0;
+	out->types[ZONE_TINY].size = TINY_MAX;
+	out->types[ZONE_SMALL].size = SMALL_MAX;
+	t_malloc_class_stats *all[2] = {out->types, out->classes};
+	size_t counts[2] = {3, MALLOC_STATS_CLASSES};
+	for (int k = 0; k < 2; ++k)
+		for (size_t i = 0; i < counts[k]; ++i)
+		{
+			t_malloc_class_stats *c = &all[k][i];
+			c->live_objects = c->allocs >= c->frees ? c->allocs - c->frees : 0;
+			c->live_bytes = c->alloc_bytes >= c->free_bytes ? c->alloc_bytes - c->free_bytes : 0;
+		}
+	return 0;
+}
+
+static void print_class_line(const char *label, size_t size, const t_malloc_class_stats *c)
+{
+	print("%s %u : allocs=%u frees=%u live=%u live_bytes=%u bin=%u append=%u zone=%u cache=%u split=%u coalesce=%u\n",
+		  label, size, (size_t)c->allocs, (size_t)c->frees, (size_t)c->live_objects, (size_t)c->live_bytes,
+		  (size_t)c->bin_hits, (size_t)c->append_allocs, (size_t)c->zone_allocs, (size_t)c->cache_hits,
+		  (size_t)c->splits, (size_t)c->coalesces);
+}
+
+void malloc_stats(void)
+{
+	// Large struct: keep it off the (possibly small) caller stack.
+	t_malloc_stats *st = mmap(NULL, sizeof(*st), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (st == MAP_FAILED)
+		return;
+	malloc_stats_get(st);
+	print("mapped=%u resident=%u dirty=%u\n", st->mapped, st->resident, st->dirty);
+	for (int t = 0; t < 3; ++t)
+	{
+		print("%s zones=%u\n", zone_type_to_string((t_zone_type)t), st->zones[t]);
+		print_class_line(zone_type_to_string((t_zone_type)t), st->types[t].size, &st->types[t]);
+	}
+	for (size_t i = 0; i < MALLOC_STATS_CLASSES; ++i)
+		if (st->classes[i].allocs || st->classes[i].frees)
+			print_class_line("class", st->classes[i].size, &st->classes[i]);
+	munmap(st, sizeof(*st));
+}
@@ -1,11 +1,26 @@
 #include "malloc_pthread.h"
+#include "malloc_cycles.h"
 
-// Recursive global allocator mutex state
-static struct s_malloc_mutex_state
+// Instrumented allocator mutex state
+typedef struct s_malloc_mutex_state
 {
 	pthread_mutex_t mutex;
 	pthread_once_t once;
-} g_malloc_mutex = {0};
+#ifdef MALLOC_LOCK_STATS
+	// Only touched by the current owner, so no atomics are needed.
+	unsigned depth;		  // recursion depth of the owner
+	uint64_t acquired_at; // tick of the outermost acquisition
+	t_malloc_lock_stats stats;
+#endif
+} t_malloc_mutex_state;
+
+// Recursive global allocator mutex
+static t_malloc_mutex_state g_malloc_mutex = {0};
+
+#ifdef MALLOC_PERCPU
+// Per-CPU magazine depot mutex (never taken recursively)
+static t_malloc_mutex_state g_depot_mutex = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+#endif
 
 static void malloc_mutex_init(void)
 {
@@ -16,13 +31,121 @@ static void malloc_mutex_init(void)
 	pthread_mutexattr_destroy(&attr);
 }
 
+#ifdef MALLOC_LOCK_STATS
+static void mutex_acquire(t_malloc_mutex_state *m)
+{
+	uint64_t t0 = malloc_cycles();
+	int contended = pthread_mutex_trylock(&m->mutex) != 0;
+	if (contended)
+		pthread_mutex_lock(&m->mutex);
+	if (m->depth++)
+		return;
+	t_malloc_lock_stats *s = &m->stats;
+	uint64_t t1 = malloc_cycles();
+	m->acquired_at = t1;
+	s->acquisitions++;
+	if (contended)
+	{
+		s->contended++;
+		s->wait_cycles += t1 - t0;
+		s->wait_hist[malloc_log2_bucket(t1 - t0, MALLOC_LOCK_HIST_BUCKETS)]++;
+	}
+}
+
+static void mutex_release(t_malloc_mutex_state *m)
+{
+	if (m->depth && --m->depth == 0)
+	{
+		t_malloc_lock_stats *s = &m->stats;
+		uint64_t held = malloc_cycles() - m->acquired_at;
+		s->hold_cycles += held;
+		s->hold_hist[malloc_log2_bucket(held, MALLOC_LOCK_HIST_BUCKETS)]++;
+	}
+	pthread_mutex_unlock(&m->mutex);
+}
+#else
+static void mutex_acquire(t_malloc_mutex_state *m)
+{
+	pthread_mutex_lock(&m->mutex);
+}
+
+static void mutex_release(t_malloc_mutex_state *m)
+{
+	pthread_mutex_unlock(&m->mutex);
+}
+#endif
+
 void malloc_lock(void)
 {
 	pthread_once(&g_malloc_mutex.once, malloc_mutex_init);
-	pthread_mutex_lock(&g_malloc_mutex.mutex);
+	mutex_acquire(&g_malloc_mutex);
 }
 
 void malloc_unlock(void)
 {
-	pthread_mutex_unlock(&g_malloc_mutex.mutex);
+	mutex_release(&g_malloc_mutex);
+}
+
+#ifdef MALLOC_PERCPU
+void malloc_depot_lock(void)
+{
+	mutex_acquire(&g_depot_mutex);
+}
+
+void malloc_depot_unlock(void)
+{
+	mutex_release(&g_depot_mutex);
+}
+#endif
+
+#ifdef MALLOC_LOCK_STATS
+// Records in report order; each one is copied under its own mutex.
+static const struct s_lock_record
+{
+	const char *name;
+	t_malloc_mutex_state *state;
+	void (*lock)(void);
+	void (*unlock)(void);
+} g_lock_records[] = {
+	{"global", &g_malloc_mutex, malloc_lock, malloc_unlock},
+#ifdef MALLOC_PERCPU
+	{"depot", &g_depot_mutex, malloc_depot_lock, malloc_depot_unlock},
+#endif
+};
+#define LOCK_RECORDS (sizeof(g_lock_records) / sizeof(g_lock_records[0]))
+
+size_t malloc_lock_stats(t_malloc_lock_stats *out, size_t max)
+{
+	for (size_t i = 0; out && i < max && i < LOCK_RECORDS; ++i)
+	{
+		const struct s_lock_record *r = &g_lock_records[i];
+		r->lock();
+		out[i] = r->state->stats;
+		r->unlock();
+		out[i].name = r->name;
+	}
+	return LOCK_RECORDS;
+}
+
+void malloc_lock_stats_reset(void)
+{
+	for (size_t i = 0; i < LOCK_RECORDS; ++i)
+	{
+		const struct s_lock_record *r = &g_lock_records[i];
+		r->lock();
+		r->state->stats = (t_malloc_lock_stats){0};
+		r->unlock();
+	}
+}
+#else
+size_t malloc_lock_stats(t_malloc_lock_stats *out, size_t max)
+{
+	(void)out;
+	(void)max;
+	return 0;
+}
+
+void malloc_lock_stats_reset(void)
+{
 }
+#endif
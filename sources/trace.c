@@ -0,0 +1,201 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   trace.c                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:12:03 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 14:02:37 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_malloc.h"
+#include "malloc_trace.h"
+
+#ifdef MALLOC_TRACE
+
+#include "malloc_cycles.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+
+#define TRACE_TLS __thread __attribute__((tls_model("initial-exec")))
+#define TRACE_CHUNK_BYTES (MALLOC_TRACE_CHUNK * sizeof(t_trace_record))
+
+// Per-thread writer. Everything here is only touched by its own thread.
+typedef struct s_trace_writer
+{
+	int state; // 0 = not opened yet, 1 = recording, -1 = off
+	int fd;
+	uint32_t tid;
+	t_trace_header *hdr;   // first page of the file, mapped for the thread's lifetime
+	t_trace_record *chunk; // current window of MALLOC_TRACE_CHUNK records
+	size_t chunk_index;	   // which window is mapped
+	size_t used;		   // records written in the current window
+} t_trace_writer;
+
+static TRACE_TLS t_trace_writer t_trace;
+static TRACE_TLS int t_trace_depth; // > 0 inside an allocator entry point
+
+// Thread exit closes the writer (trace_close); the key's value is &t_trace.
+static pthread_key_t g_trace_key;
+static pthread_once_t g_trace_key_once = PTHREAD_ONCE_INIT;
+
+// "<prefix>.<pid>.<tid>.trace" without snprintf (it may allocate).
+static size_t trace_put_num(char *dst, size_t n)
+{
+	char tmp[20];
+	size_t len = 0;
+	do
+		tmp[len++] = (char)('0' + n % 10);
+	while ((n /= 10));
+	for (size_t i = 0; i < len; ++i)
+		dst[i] = tmp[len - 1 - i];
+	return len;
+}
+
+static int trace_path(char *dst, size_t cap, const char *prefix, size_t pid, size_t tid)
+{
+	size_t len = 0;
+	while (prefix[len])
+		len++;
+	if (len + 56 > cap)
+		return -1;
+	for (size_t i = 0; i < len; ++i)
+		dst[i] = prefix[i];
+	dst[len++] = '.';
+	len += trace_put_num(dst + len, pid);
+	dst[len++] = '.';
+	len += trace_put_num(dst + len, tid);
+	const char *ext = ".trace";
+	for (size_t i = 0; ext[i]; ++i)
+		dst[len++] = ext[i];
+	dst[len] = '\0';
+	return 0;
+}
+
+// Grow the file by one chunk and map it as the current window. The window is
+// prefaulted in one go: page faults taken one by one on the recording path
+// would cost more than the records themselves.
+static int trace_map_chunk(t_trace_writer *w, size_t index)
+{
+	off_t off = (off_t)(MALLOC_TRACE_HEADER_SIZE + index * TRACE_CHUNK_BYTES);
+	if (ftruncate(w->fd, off + (off_t)TRACE_CHUNK_BYTES) != 0)
+		return -1;
+	void *mem = mmap(NULL, TRACE_CHUNK_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, w->fd, off);
+	if (mem == MAP_FAILED)
+		return -1;
+	if (w->chunk)
+		munmap(w->chunk, TRACE_CHUNK_BYTES);
+	w->chunk = (t_trace_record *)mem;
+	w->chunk_index = index;
+	w->used = 0;
+	return 0;
+}
+
+// Thread-exit destructor: cut the file back to its last record, then drop the
+// mappings and the fd, also when recording stopped early (state -1 with the
+// file still open). Calls made by later destructors are not recorded.
+static void trace_close(void *arg)
+{
+	t_trace_writer *w = arg;
+	if (!w->hdr)
+		return;
+	w->state = -1;
+	size_t records = w->chunk_index * MALLOC_TRACE_CHUNK + w->used;
+	munmap(w->chunk, TRACE_CHUNK_BYTES);
+	munmap(w->hdr, MALLOC_TRACE_HEADER_SIZE);
+	w->chunk = NULL;
+	w->hdr = NULL;
+	ftruncate(w->fd, (off_t)(MALLOC_TRACE_HEADER_SIZE + records * sizeof(t_trace_record)));
+	close(w->fd);
+}
+
+static void trace_key_create(void)
+{
+	pthread_key_create(&g_trace_key, trace_close);
+}
+
+static void trace_open(t_trace_writer *w)
+{
+	w->state = -1;
+	const char *prefix = getenv(MALLOC_TRACE_ENV);
+	if (!prefix || !*prefix)
+		return;
+	char path[4096];
+	w->tid = (uint32_t)syscall(SYS_gettid);
+	if (trace_path(path, sizeof(path), prefix, (size_t)getpid(), w->tid) != 0)
+		return;
+	w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (w->fd < 0)
+		return;
+	void *hdr = MAP_FAILED;
+	if (ftruncate(w->fd, (off_t)MALLOC_TRACE_HEADER_SIZE) == 0)
+		hdr = mmap(NULL, MALLOC_TRACE_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+	if (hdr == MAP_FAILED)
+	{
+		close(w->fd);
+		return;
+	}
+	w->hdr = (t_trace_header *)hdr;
+	if (trace_map_chunk(w, 0) != 0)
+	{
+		munmap(hdr, MALLOC_TRACE_HEADER_SIZE);
+		w->hdr = NULL;
+		close(w->fd);
+		return;
+	}
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	*w->hdr = (t_trace_header){.magic = MALLOC_TRACE_MAGIC,
+							   .version = MALLOC_TRACE_VERSION,
+							   .record_size = sizeof(t_trace_record),
+							   .tid = w->tid,
+							   .t0_cycles = malloc_cycles(),
+							   .t0_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec};
+	w->state = 1;
+	pthread_once(&g_trace_key_once, trace_key_create);
+	pthread_setspecific(g_trace_key, w);
+}
+
+void malloc_trace_event(t_trace_op op, void *ptr, size_t size, void *result)
+{
+	t_trace_writer *w = &t_trace;
+	if (t_trace_depth || w->state < 0)
+		return;
+	if (!w->state)
+	{
+		t_trace_depth++; // the open path must not record itself
+		trace_open(w);
+		t_trace_depth--;
+		if (w->state < 0)
+			return;
+	}
+	if (w->used == MALLOC_TRACE_CHUNK && trace_map_chunk(w, w->chunk_index + 1) != 0)
+	{
+		w->state = -1; // out of disk or address space: stop, keep what we have (trace_close still runs)
+		return;
+	}
+	t_trace_record *r = &w->chunk[w->used++];
+	r->ts = malloc_cycles();
+	r->ptr = (uintptr_t)ptr;
+	r->result = (uintptr_t)result;
+	r->size = size;
+	r->tid = w->tid;
+	r->op = (uint32_t)op;
+	w->hdr->count++;
+}
+
+void malloc_trace_enter(void)
+{
+	t_trace_depth++;
+}
+
+void malloc_trace_leave(void)
+{
+	t_trace_depth--;
+}
+
+#endif
@@ -0,0 +1,211 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   bench_aging.c                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 19:10:44 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 19:10:44 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "malloc_frag.h"
+
+/*
+ * Heap aging: a long run of a service-like workload, sampled every K steps.
+ * Each step frees one object and allocates its replacement in one of three
+ * lifetime classes (random replacement in a fixed set, so lifetimes are
+ * geometric with the mean given below). Sizes are log-uniform over a 3-octave
+ * window that sweeps 16 B .. 4 KiB and back every DRIFT_PERIOD steps (TINY and
+ * SMALL only: LARGE blocks are mapped one by one and do not age), and
+ * every BURST_EVERY steps a burst of objects is allocated, held while normal
+ * traffic goes on, then released.
+ * CSV: ops,seconds,rss_kb,live_kb,rss_per_live,zones,heap_kb,free_kb,tail_kb,
+ *      external_tiny,external_small
+ * (zones and after come from malloc_frag_get and are empty on libc.)
+ */
+
+#define SHORT_SLOTS 64 /* mean lifetime ~ 80 steps */
+#define MEDIUM_SLOTS 16384 /* ~ 90k steps */
+#define LONG_SLOTS 65536 /* ~ 3.3M steps */
+#define SHORT_PCT 80
+#define MEDIUM_PCT 18 /* long: the remaining 2% */
+#define WINDOW_OCTAVES 3
+#define MIN_OCTAVE 4 /* 16 bytes */
+#define MAX_OCTAVE 9 /* highest window: 512 B .. 4 KiB */
+#define DRIFT_PERIOD 4000000UL
+#define BURST_EVERY 1000000UL
+#define BURST_HOLD 250000UL
+#define BURST_OBJECTS 20000
+
+/* Present in libft_malloc only. */
+extern int malloc_frag_get(t_malloc_frag *out) __attribute__((weak));
+
+typedef struct s_pool
+{
+	void **ptr;
+	size_t *size;
+	size_t slots;
+} t_pool;
+
+static size_t g_live; /* requested bytes currently allocated */
+
+static void *map_anon(size_t bytes)
+{
+	void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return p == MAP_FAILED ? NULL : p;
+}
+
+static int pool_init(t_pool *p, size_t slots)
+{
+	p->slots = slots;
+	p->ptr = map_anon(slots * sizeof(void *));
+	p->size = map_anon(slots * sizeof(size_t));
+	return p->ptr && p->size ? 0 : -1;
+}
+
+static uint64_t xorshift64(uint64_t *s)
+{
+	uint64_t x = *s;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*s = x;
+	return x;
+}
+
+/* Lowest octave of the size window at `step`: a triangle wave. */
+static unsigned window_start(size_t step)
+{
+	size_t span = MAX_OCTAVE - MIN_OCTAVE;
+	size_t phase = step % DRIFT_PERIOD;
+	size_t half = DRIFT_PERIOD / 2;
+	size_t pos = phase < half ? phase : DRIFT_PERIOD - phase;
+	return (unsigned)(MIN_OCTAVE + pos * span / half);
+}
+
+static size_t draw_size(size_t step, uint64_t *seed)
+{
+	uint64_t r = xorshift64(seed);
+	unsigned octave = window_start(step) + (unsigned)(r % WINDOW_OCTAVES);
+	size_t base = (size_t)1 << octave;
+	return base + (size_t)((r >> 8) % base);
+}
+
+static void put(t_pool *p, size_t slot, size_t sz)
+{
+	if (p->ptr[slot])
+	{
+		free(p->ptr[slot]);
+		g_live -= p->size[slot];
+	}
+	p->ptr[slot] = malloc(sz);
+	p->size[slot] = p->ptr[slot] ? sz : 0;
+	if (p->ptr[slot])
+	{
+		for (size_t off = 0; off < sz; off += 4096) /* one write per page, as a user would */
+			((char *)p->ptr[slot])[off] = 0x5A;
+		g_live += sz;
+	}
+}
+
+static void release_all(t_pool *p)
+{
+	for (size_t i = 0; i < p->slots; ++i)
+		if (p->ptr[i])
+		{
+			free(p->ptr[i]);
+			g_live -= p->size[i];
+			p->ptr[i] = NULL;
+		}
+}
+
+static long rss_kb(void)
+{
+	char buf[256];
+	int fd = open("/proc/self/statm", O_RDONLY);
+	if (fd < 0)
+		return -1;
+	ssize_t n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+	buf[n] = '\0';
+	char *p = strchr(buf, ' ');
+	long ps = sysconf(_SC_PAGESIZE);
+	return p ? strtol(p + 1, NULL, 10) * (ps > 0 ? ps : 4096) / 1024 : -1;
+}
+
+static void sample(size_t step, double seconds)
+{
+	static t_malloc_frag frag;
+	long rss = rss_kb();
+	double live_kb = (double)g_live / 1024.0;
+	printf("%zu,%.3f,%ld,%.0f,%.3f", step, seconds, rss, live_kb, live_kb > 0 ? (double)rss / live_kb : 0.0);
+	if (malloc_frag_get && malloc_frag_get(&frag) == 0)
+	{
+		size_t zones = 0, heap = 0, freeb = 0, tail = 0;
+		for (int t = 0; t < 3; ++t)
+		{
+			zones += frag.types[t].zones;
+			heap += frag.types[t].capacity;
+			freeb += frag.types[t].free_bytes;
+			tail += frag.types[t].tail_slack;
+		}
+		printf(",%zu,%zu,%zu,%zu,%.3f,%.3f\n", zones, heap / 1024, freeb / 1024, tail / 1024,
+			   frag.types[ZONE_TINY].external, frag.types[ZONE_SMALL].external);
+	}
+	else
+		printf(",,,,,,\n");
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	size_t total = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000UL;
+	size_t every = argc > 2 ? strtoull(argv[2], NULL, 10) : 100000UL;
+	uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 0x2545F4914F6CDD1DULL;
+	if (!total || !every || !seed)
+	{
+		fprintf(stderr, "Usage: %s [steps] [sample_every] [seed]\n"
+						"  (default: 10000000 steps, a sample every 100000)\n",
+				argv[0]);
+		return 1;
+	}
+	t_pool pools[3], burst;
+	if (pool_init(&pools[0], SHORT_SLOTS) || pool_init(&pools[1], MEDIUM_SLOTS) || pool_init(&pools[2], LONG_SLOTS) ||
+		pool_init(&burst, BURST_OBJECTS))
+		return 1;
+	printf("# %s\n", bench_allocator());
+	double t0 = bench_now_sec();
+	for (size_t step = 0; step < total; ++step)
+	{
+		if (step % every == 0)
+			sample(step, bench_now_sec() - t0);
+		if (step % BURST_EVERY == 0)
+			for (size_t i = 0; i < BURST_OBJECTS; ++i)
+				put(&burst, i, draw_size(step, &seed));
+		else if (step % BURST_EVERY == BURST_HOLD)
+			release_all(&burst);
+		uint64_t r = xorshift64(&seed);
+		unsigned pct = (unsigned)(r % 100);
+		t_pool *p = &pools[pct < SHORT_PCT ? 0 : pct < SHORT_PCT + MEDIUM_PCT ? 1 : 2];
+		put(p, (size_t)((r >> 8) % p->slots), draw_size(step, &seed));
+	}
+	sample(total, bench_now_sec() - t0);
+	return 0;
+}
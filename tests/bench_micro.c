@@ -10,8 +10,8 @@
 /*                                                                            */
 /* ************************************************************************** */
 
-#ifndef _POSIX_C_SOURCE
-#define _POSIX_C_SOURCE 200809L
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
 #endif
 
 #include <stdio.h>
@@ -20,12 +20,113 @@
 #include <string.h>
 #include <time.h>
 
-/* High resolution time helper */
+#include "bench.h"
+
+/* Per-operation latency, in malloc_cycles() ticks, for the running scenario. */
+enum e_op
+{
+	OP_MALLOC,
+	OP_FREE,
+	OP_REALLOC,
+	OP_COUNT
+};
+
+static const char *g_op_names[OP_COUNT] = {"malloc", "free", "realloc"};
+static t_bench_hist g_hist[OP_COUNT];
+static uint64_t g_timer_cost; /* ticks of an empty timed region, subtracted */
+static int g_csv;
+static double g_tpn = 1.0; /* ticks per ns */
+static t_bench_perf g_perf; /* hardware counters, scenario-wide */
+
 static double now_sec(void)
 {
-	struct timespec ts;
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+	return bench_now_sec();
+}
+
+/* Scenario bounds: counters run between the two wall-clock reads. */
+static double scenario_begin(void)
+{
+	bench_perf_start(&g_perf);
+	return now_sec();
+}
+
+static double scenario_end(void)
+{
+	double t = now_sec();
+	bench_perf_stop(&g_perf);
+	return t;
+}
+
+static void record(enum e_op op, uint64_t c0, uint64_t c1)
+{
+	uint64_t d = c1 - c0;
+	bench_hist_add(&g_hist[op], d > g_timer_cost ? d - g_timer_cost : 0);
+}
+
+static void *timed_malloc(size_t sz)
+{
+	uint64_t c0 = malloc_cycles();
+	void *p = malloc(sz);
+	record(OP_MALLOC, c0, malloc_cycles());
+	return p;
+}
+
+static void timed_free(void *p)
+{
+	uint64_t c0 = malloc_cycles();
+	free(p);
+	record(OP_FREE, c0, malloc_cycles());
+}
+
+static void *timed_realloc(void *p, size_t sz)
+{
+	uint64_t c0 = malloc_cycles();
+	void *n = realloc(p, sz);
+	record(OP_REALLOC, c0, malloc_cycles());
+	return n;
+}
+
+/* Median cost of two back-to-back counter reads. */
+static uint64_t measure_timer_cost(void)
+{
+	t_bench_hist h = {0};
+	for (int i = 0; i < 10000; ++i)
+	{
+		uint64_t c0 = malloc_cycles();
+		bench_hist_add(&h, malloc_cycles() - c0);
+	}
+	return bench_hist_percentile(&h, 0.5);
+}
+
+/* Print the per-op percentiles of the scenario that just ran, then reset.
+ * Counters cover the whole scenario and are divided by its operation count. */
+static void report(const char *scenario, double seconds)
+{
+	double tpn = g_tpn;
+	double ops = (double)(g_hist[OP_MALLOC].count + g_hist[OP_FREE].count + g_hist[OP_REALLOC].count);
+	for (int op = 0; op < OP_COUNT; ++op)
+	{
+		const t_bench_hist *h = &g_hist[op];
+		if (!h->count)
+			continue;
+		double mean = (double)h->sum / (double)h->count / tpn;
+		double p50 = bench_hist_percentile(h, 0.50) / tpn, p90 = bench_hist_percentile(h, 0.90) / tpn;
+		double p99 = bench_hist_percentile(h, 0.99) / tpn, p999 = bench_hist_percentile(h, 0.999) / tpn;
+		double max = (double)h->max / tpn;
+		if (g_csv)
+		{
+			printf("%s,%s,%s,%llu,%.6f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f", scenario, bench_allocator(), g_op_names[op],
+				   (unsigned long long)h->count, seconds, mean, p50, p90, p99, p999, max);
+			bench_perf_csv(&g_perf, ops);
+			printf("\n");
+		}
+		else
+			printf("  %-7s n=%-9llu mean=%.0f p50=%.0f p90=%.0f p99=%.0f p99.9=%.0f max=%.0f ns\n", g_op_names[op],
+				   (unsigned long long)h->count, mean, p50, p90, p99, p999, max);
+	}
+	if (!g_csv)
+		bench_perf_print(&g_perf, "  perf   ", ops);
+	memset(g_hist, 0, sizeof(g_hist));
 }
 
 static uint64_t xorshift64(uint64_t *s)
@@ -49,31 +150,35 @@ static void touch(void *p, size_t sz)
 /* Scenario 1: fixed size alloc/free loop */
 static void bench_fixed(size_t iters, size_t sz)
 {
-	double t0 = now_sec();
+	double t0 = scenario_begin();
 	for (size_t i = 0; i < iters; ++i)
 	{
-		void *p = malloc(sz);
+		void *p = timed_malloc(sz);
 		touch(p, sz);
-		free(p);
+		timed_free(p);
 	}
-	double t1 = now_sec();
-	printf("fixed,%zu,%zu,%.6f\n", iters, sz, t1 - t0);
+	double t1 = scenario_end();
+	if (!g_csv)
+		printf("fixed,%zu,%zu,%.6f\n", iters, sz, t1 - t0);
+	report("fixed", t1 - t0);
 }
 
 /* Scenario 2: random size <= max, immediate free */
 static void bench_rand_sizes(size_t iters, size_t max_sz)
 {
 	uint64_t seed = 0x123456789ABCDEF0ULL;
-	double t0 = now_sec();
+	double t0 = scenario_begin();
 	for (size_t i = 0; i < iters; ++i)
 	{
 		size_t sz = (xorshift64(&seed) % max_sz) + 1;
-		void *p = malloc(sz);
+		void *p = timed_malloc(sz);
 		touch(p, sz);
-		free(p);
+		timed_free(p);
 	}
-	double t1 = now_sec();
-	printf("rand_immediate,%zu,%zu,%.6f\n", iters, max_sz, t1 - t0);
+	double t1 = scenario_end();
+	if (!g_csv)
+		printf("rand_immediate,%zu,%zu,%.6f\n", iters, max_sz, t1 - t0);
+	report("rand_immediate", t1 - t0);
 }
 
 /* Scenario 3: working set of pointers with churn */
@@ -86,39 +191,41 @@ static void bench_working_set(size_t iters, size_t set_size, size_t max_sz)
 		return;
 	}
 	uint64_t seed = 0xCAFEBABEDEADBEEFULL;
-	double t0 = now_sec();
+	double t0 = scenario_begin();
 	for (size_t i = 0; i < iters; ++i)
 	{
 		size_t idx = xorshift64(&seed) % set_size;
 		if (set[idx])
 		{
-			free(set[idx]);
+			timed_free(set[idx]);
 			set[idx] = NULL;
 		}
 		size_t sz = (xorshift64(&seed) % max_sz) + 1;
-		set[idx] = malloc(sz);
+		set[idx] = timed_malloc(sz);
 		touch(set[idx], sz);
 	}
 	for (size_t i = 0; i < set_size; ++i)
-		free(set[i]);
+		timed_free(set[i]);
 	free(set);
-	double t1 = now_sec();
-	printf("working_set,%zu,%zu/%zu,%.6f\n", iters, set_size, max_sz, t1 - t0);
+	double t1 = scenario_end();
+	if (!g_csv)
+		printf("working_set,%zu,%zu/%zu,%.6f\n", iters, set_size, max_sz, t1 - t0);
+	report("working_set", t1 - t0);
 }
 
 /* Scenario 4: realloc growth + occasional shrink */
 static void bench_realloc(size_t iters, size_t start_sz, size_t max_sz)
 {
 	uint64_t seed = 0xA55A55A55ULL;
-	void *p = malloc(start_sz);
+	void *p = timed_malloc(start_sz);
 	size_t cur = start_sz;
-	double t0 = now_sec();
+	double t0 = scenario_begin();
 	for (size_t i = 0; i < iters; ++i)
 	{
 		size_t target = (xorshift64(&seed) % max_sz) + 1;
 		if (target > cur)
 		{
-			void *n = realloc(p, target);
+			void *n = timed_realloc(p, target);
 			if (n)
 			{
 				p = n;
@@ -127,7 +234,7 @@ static void bench_realloc(size_t iters, size_t start_sz, size_t max_sz)
 		}
 		else if ((i & 0x7) == 0)
 		{ /* occasional shrink */
-			void *n = realloc(p, target);
+			void *n = timed_realloc(p, target);
 			if (n)
 			{
 				p = n;
@@ -136,9 +243,11 @@ static void bench_realloc(size_t iters, size_t start_sz, size_t max_sz)
 		}
 		touch(p, cur);
 	}
-	free(p);
-	double t1 = now_sec();
-	printf("realloc_mix,%zu,%zu-%zu,%.6f\n", iters, start_sz, max_sz, t1 - t0);
+	timed_free(p);
+	double t1 = scenario_end();
+	if (!g_csv)
+		printf("realloc_mix,%zu,%zu-%zu,%.6f\n", iters, start_sz, max_sz, t1 - t0);
+	report("realloc_mix", t1 - t0);
 }
 
 /* Scenario 5: fragmentation stress (allocate many, free pattern, reallocate) */
@@ -150,48 +259,65 @@ static void bench_fragment(size_t blocks, size_t block_sz)
 		fprintf(stderr, "fragment arr alloc fail\n");
 		return;
 	}
+	double t0 = scenario_begin();
 	for (size_t i = 0; i < blocks; ++i)
 	{
-		arr[i] = malloc(block_sz);
+		arr[i] = timed_malloc(block_sz);
 		touch(arr[i], block_sz);
 	}
 	/* free every other */
 	for (size_t i = 0; i < blocks; i += 2)
 	{
-		free(arr[i]);
+		timed_free(arr[i]);
 		arr[i] = NULL;
 	}
 	/* allocate new blocks for freed spots with slightly different size */
 	size_t new_sz = block_sz / 2 + 1;
 	for (size_t i = 0; i < blocks; i += 2)
 	{
-		arr[i] = malloc(new_sz);
+		arr[i] = timed_malloc(new_sz);
 		touch(arr[i], new_sz);
 	}
 	/* free all */
 	for (size_t i = 0; i < blocks; ++i)
-		free(arr[i]);
+		timed_free(arr[i]);
+	double t1 = scenario_end();
 	free(arr);
-	/* Not timed in phases to keep output compact; measure total time */
-	// Could extend to separate phases if needed.
-	printf("fragment_pattern,%zu,%zu->%zu,done\n", blocks, block_sz, new_sz);
+	/* Not timed in phases to keep output compact; the histograms show the tails */
+	if (!g_csv)
+		printf("fragment_pattern,%zu,%zu->%zu,%.6f\n", blocks, block_sz, new_sz, t1 - t0);
+	report("fragment_pattern", t1 - t0);
 }
 
 static void usage(const char *prog)
 {
 	fprintf(stderr,
-			"Usage: %s [scenario] [args...]\n"
-			"Scenarios (CSV output):\n"
+			"Usage: %s [--csv] [scenario] [args...]\n"
+			"Scenarios (CSV output, then per-op latency percentiles):\n"
 			"  fixed iters size\n"
 			"  rand iters max_size\n"
 			"  ws iters set_size max_size\n"
 			"  realloc iters start max\n"
-			"  frag blocks block_size\n",
+			"  frag blocks block_size\n"
+			"--csv: only per-op rows\n"
+			"  scenario,allocator,op,count,seconds,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,\n"
+			"  instructions,cycles,l1d_misses,llc_misses,dtlb_misses,branch_misses,page_faults\n"
+			"Counters are per operation over the whole scenario (empty/n/a when the\n"
+			"kernel or CPU does not provide them).\n",
 			prog);
 }
 
 int main(int argc, char **argv)
 {
+	if (argc > 1 && !strcmp(argv[1], "--csv"))
+	{
+		g_csv = 1;
+		argv++;
+		argc--;
+	}
+	g_tpn = bench_ticks_per_ns();
+	bench_perf_open(&g_perf);
+	g_timer_cost = measure_timer_cost();
 	if (argc < 2)
 	{
 		usage(argv[0]);
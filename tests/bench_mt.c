@@ -0,0 +1,402 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   bench_mt.c                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 17:31:09 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 17:31:09 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+/*
+ * Multithreaded scaling scenarios, each run at 1, 2, 4 ... max threads.
+ * CSV: scenario,allocator,threads,ops,seconds,ops_per_sec,speedup, then the
+ * hardware counters per op (instructions,cycles,l1d_misses,llc_misses,
+ * dtlb_misses,branch_misses,page_faults; empty when unavailable) summed over
+ * all worker threads, thread start-up included.
+ * (ops = malloc + free calls, or object writes for the false-sharing
+ * scenarios; speedup is against the 1-thread run).
+ */
+
+#define MAX_THREADS 256
+#define CACHE_LINE 64
+#define LOCAL_SLOTS 256
+#define QUEUE_SIZE 1024
+#define POOL_SLOTS 4096
+#define LARSON_SLOTS 1024
+#define LARSON_ROUNDS 8
+#define MIN_SIZE 8
+#define MAX_SIZE 512
+#define SHARE_SIZE 8	/* object size of the false-sharing scenarios */
+#define SHARE_WRITES 1000 /* writes per object (Hoard uses the same order) */
+
+typedef struct s_worker
+{
+	pthread_t th;
+	size_t id;
+	size_t threads;
+	size_t ops; /* operations to perform */
+	uint64_t seed;
+	void **slots; /* larson: the object array this thread inherited */
+	double t0;	  /* after the start barrier */
+	double t1;	  /* work done */
+	double done_ops;
+	uintptr_t first; /* false sharing: address of the first object written */
+} t_worker;
+
+typedef struct s_scenario
+{
+	const char *name;
+	void *(*run)(void *);
+	int rounds; /* > 1: threads are re-created each round (larson) */
+	void (*setup)(size_t threads); /* before the threads start (optional) */
+} t_scenario;
+
+/* Single-producer / single-consumer ring, one per thread. */
+typedef struct s_queue
+{
+	_Alignas(CACHE_LINE) size_t head; /* written by the consumer */
+	_Alignas(CACHE_LINE) size_t tail; /* written by the producer */
+	_Alignas(CACHE_LINE) void *items[QUEUE_SIZE];
+} t_queue;
+
+static pthread_barrier_t g_start;
+static t_queue g_queues[MAX_THREADS];
+static void *g_pool[POOL_SLOTS];
+static void **g_larson[MAX_THREADS];
+static void *g_scratch[MAX_THREADS];
+
+static uint64_t xorshift64(uint64_t *s)
+{
+	uint64_t x = *s;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*s = x;
+	return x;
+}
+
+static size_t rand_size(uint64_t *seed)
+{
+	return MIN_SIZE + xorshift64(seed) % (MAX_SIZE - MIN_SIZE + 1);
+}
+
+/* Workers stamp their own start/end: on few CPUs the main thread may only
+ * run again after the work is over. */
+static void start(t_worker *w)
+{
+	pthread_barrier_wait(&g_start);
+	w->t0 = bench_now_sec();
+}
+
+static void *done(t_worker *w, double ops)
+{
+	w->t1 = bench_now_sec();
+	w->done_ops = ops;
+	return NULL;
+}
+
+static void *alloc_touch(size_t sz)
+{
+	char *p = malloc(sz);
+	if (p)
+		p[0] = (char)sz;
+	return p;
+}
+
+/* Scenario 1: every thread churns its own working set. */
+static void *run_local(void *arg)
+{
+	t_worker *w = arg;
+	void *slots[LOCAL_SLOTS] = {0};
+	start(w);
+	for (size_t i = 0; i < w->ops; ++i)
+	{
+		size_t idx = xorshift64(&w->seed) % LOCAL_SLOTS;
+		free(slots[idx]);
+		slots[idx] = alloc_touch(rand_size(&w->seed));
+	}
+	for (size_t i = 0; i < LOCAL_SLOTS; ++i)
+		free(slots[i]);
+	return done(w, 2.0 * (double)w->ops);
+}
+
+/* Scenario 2: thread i allocates into queue i, thread i + 1 frees from it. */
+static void *run_prodcons(void *arg)
+{
+	t_worker *w = arg;
+	t_queue *out = &g_queues[w->id];
+	t_queue *in = &g_queues[(w->id + w->threads - 1) % w->threads];
+	size_t produced = 0, consumed = 0;
+	start(w);
+	while (produced < w->ops || consumed < w->ops)
+	{
+		int progress = 0;
+		size_t tail = out->tail;
+		if (produced < w->ops && tail - __atomic_load_n(&out->head, __ATOMIC_ACQUIRE) < QUEUE_SIZE)
+		{
+			out->items[tail % QUEUE_SIZE] = alloc_touch(rand_size(&w->seed));
+			__atomic_store_n(&out->tail, tail + 1, __ATOMIC_RELEASE);
+			produced++;
+			progress = 1;
+		}
+		size_t head = in->head;
+		if (head != __atomic_load_n(&in->tail, __ATOMIC_ACQUIRE))
+		{
+			free(in->items[head % QUEUE_SIZE]);
+			__atomic_store_n(&in->head, head + 1, __ATOMIC_RELEASE);
+			consumed++;
+			progress = 1;
+		}
+		if (!progress)
+			sched_yield(); /* queue full / empty: let the peer run (oversubscribed runs) */
+	}
+	return done(w, 2.0 * (double)w->ops);
+}
+
+/* Scenario 3: a shared pool; whoever replaces a slot frees its previous owner's block. */
+static void *run_pool(void *arg)
+{
+	t_worker *w = arg;
+	start(w);
+	for (size_t i = 0; i < w->ops; ++i)
+	{
+		size_t idx = xorshift64(&w->seed) % POOL_SLOTS;
+		void *old = __atomic_exchange_n(&g_pool[idx], alloc_touch(rand_size(&w->seed)), __ATOMIC_ACQ_REL);
+		free(old);
+	}
+	return done(w, 2.0 * (double)w->ops);
+}
+
+/* Scenario 4: Larson-style server. Each round, a fresh thread inherits the
+ * objects of the previous one and keeps replacing them at random. */
+static void *run_larson(void *arg)
+{
+	t_worker *w = arg;
+	void **slots = w->slots;
+	start(w);
+	for (size_t i = 0; i < w->ops; ++i)
+	{
+		size_t idx = xorshift64(&w->seed) % LARSON_SLOTS;
+		free(slots[idx]);
+		slots[idx] = alloc_touch(rand_size(&w->seed));
+	}
+	return done(w, 2.0 * (double)w->ops);
+}
+
+/* Write `obj` SHARE_WRITES times; volatile keeps every store in the loop. */
+static void hammer(t_worker *w, char *obj)
+{
+	volatile char *v = obj;
+	if (!w->first)
+		w->first = (uintptr_t)obj;
+	for (size_t k = 0; k < SHARE_WRITES; ++k)
+		v[0] = (char)(v[0] + 1);
+}
+
+/* Scenario 5 (Hoard active-false): each thread allocates, writes and frees
+ * its own small objects. Neighbouring objects handed to different threads
+ * share cache lines and every write invalidates the other cores' copy. */
+static void *run_active_false(void *arg)
+{
+	t_worker *w = arg;
+	size_t iters = w->ops; /* each: malloc, SHARE_WRITES writes, free */
+	start(w);
+	for (size_t i = 0; i < iters; ++i)
+	{
+		char *p = malloc(SHARE_SIZE);
+		if (p)
+			hammer(w, p);
+		free(p);
+	}
+	return done(w, (double)(iters * SHARE_WRITES));
+}
+
+/* Scenario 6 (Hoard cache-scratch): the main thread allocates one object per
+ * thread back to back; each thread frees its object, then allocates, writes
+ * and frees. An allocator that hands the freed (shared-line) memory back to
+ * the thread scratches the line for as long as the run lasts. */
+static void setup_scratch(size_t threads)
+{
+	for (size_t t = 0; t < threads; ++t)
+		g_scratch[t] = malloc(SHARE_SIZE);
+}
+
+static void *run_cache_scratch(void *arg)
+{
+	t_worker *w = arg;
+	size_t iters = w->ops; /* each: malloc, SHARE_WRITES writes, free */
+	start(w);
+	free(g_scratch[w->id]);
+	g_scratch[w->id] = NULL;
+	for (size_t i = 0; i < iters; ++i)
+	{
+		char *p = malloc(SHARE_SIZE);
+		if (p)
+			hammer(w, p);
+		free(p);
+	}
+	return done(w, (double)(iters * SHARE_WRITES));
+}
+
+static const t_scenario g_scenarios[] = {
+	{"local", run_local, 1, NULL},
+	{"prodcons", run_prodcons, 1, NULL},
+	{"pool", run_pool, 1, NULL},
+	{"larson", run_larson, LARSON_ROUNDS, NULL},
+	{"active-false", run_active_false, 1, NULL},
+	{"cache-scratch", run_cache_scratch, 1, setup_scratch},
+};
+
+/* Threads whose first object shares a 64-byte line with another thread's. */
+static size_t count_shared_lines(const t_worker *workers, size_t threads)
+{
+	size_t shared = 0;
+	for (size_t a = 0; a < threads; ++a)
+		for (size_t b = 0; b < threads; ++b)
+			if (a != b && workers[a].first && workers[a].first / CACHE_LINE == workers[b].first / CACHE_LINE)
+			{
+				shared++;
+				break;
+			}
+	return shared;
+}
+
+static void reset_shared(size_t threads)
+{
+	memset(g_queues, 0, sizeof(g_queues));
+	for (size_t i = 0; i < POOL_SLOTS; ++i)
+	{
+		free(g_pool[i]);
+		g_pool[i] = NULL;
+	}
+	for (size_t t = 0; t < MAX_THREADS; ++t)
+	{
+		if (!g_larson[t] && t < threads)
+			g_larson[t] = calloc(LARSON_SLOTS, sizeof(void *));
+		for (size_t i = 0; g_larson[t] && i < LARSON_SLOTS; ++i)
+		{
+			free(g_larson[t][i]);
+			g_larson[t][i] = NULL;
+		}
+	}
+}
+
+/* One measurement: `threads` workers doing `ops` iterations each. Returns
+ * seconds; `total_ops` and `shared` (see count_shared_lines) are filled. */
+static double run_scenario(const t_scenario *sc, size_t threads, size_t ops, double *total_ops, size_t *shared,
+						   t_bench_perf *perf)
+{
+	static t_worker workers[MAX_THREADS];
+	double total = 0;
+	reset_shared(threads);
+	*total_ops = 0;
+	*shared = 0;
+	bench_perf_start(perf); /* inherited by the workers, folded back on join */
+	for (int r = 0; r < sc->rounds; ++r)
+	{
+		if (sc->setup)
+			sc->setup(threads);
+		pthread_barrier_init(&g_start, NULL, (unsigned)threads + 1);
+		for (size_t t = 0; t < threads; ++t)
+		{
+			workers[t] = (t_worker){.id = t, .threads = threads, .ops = ops / (size_t)sc->rounds,
+									.seed = 0x9E3779B97F4A7C15ULL * (t + 1) + (uint64_t)r, .slots = g_larson[t]};
+			pthread_create(&workers[t].th, NULL, sc->run, &workers[t]);
+		}
+		pthread_barrier_wait(&g_start);
+		double t0 = 0, t1 = 0;
+		for (size_t t = 0; t < threads; ++t)
+		{
+			pthread_join(workers[t].th, NULL);
+			if (!t || workers[t].t0 < t0)
+				t0 = workers[t].t0;
+			if (workers[t].t1 > t1)
+				t1 = workers[t].t1;
+			*total_ops += workers[t].done_ops;
+		}
+		total += t1 - t0;
+		*shared += count_shared_lines(workers, threads);
+		pthread_barrier_destroy(&g_start);
+	}
+	bench_perf_stop(perf);
+	return total;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+			"Usage: %s [scenario|all] [max_threads] [ops_per_thread]\n"
+			"Scenarios: local, prodcons, pool, larson, active-false, cache-scratch\n"
+			"(default: all, nproc threads, 200000 ops)\n",
+			prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *which = argc > 1 ? argv[1] : "all";
+	long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t max_threads = argc > 2 ? strtoull(argv[2], NULL, 10) : (size_t)(nproc > 0 ? nproc : 1);
+	size_t ops = argc > 3 ? strtoull(argv[3], NULL, 10) : 200000;
+	if (!max_threads || max_threads > MAX_THREADS || !ops)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	const char *alloc = bench_allocator();
+	t_bench_perf perf;
+	bench_perf_open(&perf);
+	int found = 0;
+	for (size_t s = 0; s < sizeof(g_scenarios) / sizeof(g_scenarios[0]); ++s)
+	{
+		const t_scenario *sc = &g_scenarios[s];
+		if (strcmp(which, "all") && strcmp(which, sc->name))
+			continue;
+		found = 1;
+		double base = 0;
+		for (size_t threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads)
+		{
+			double total_ops;
+			size_t shared;
+			double sec = run_scenario(sc, threads, ops, &total_ops, &shared, &perf);
+			double rate = sec > 0 ? total_ops / sec : 0;
+			if (threads == 1)
+				base = rate;
+			printf("%s,%s,%zu,%.0f,%.6f,%.0f,%.2f", sc->name, alloc, threads, total_ops, sec, rate,
+				   base > 0 ? rate / base : 0);
+			bench_perf_csv(&perf, total_ops);
+			printf("\n");
+			if (shared)
+				printf("# %s,%s,%zu: %zu of %zu threads wrote to a cache line shared with another thread\n", sc->name,
+					   alloc, threads, shared, threads);
+			fflush(stdout);
+			if (threads == max_threads)
+				break;
+		}
+	}
+	reset_shared(0);
+	bench_perf_close(&perf);
+	if (!found)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	return 0;
+}
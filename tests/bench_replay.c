@@ -0,0 +1,331 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   bench_replay.c                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:58:40 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 16:58:40 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "malloc_trace.h"
+
+/*
+ * Replays `make TRACE=1` trace files (one per recorded thread) against the
+ * allocator linked in: bench_replay.out uses libc, bench_replay_custom.out
+ * this library. Records of all files are merged by timestamp and replayed on
+ * one thread. The bench's own memory (records, pointer map) comes from mmap so
+ * it does not disturb the allocator under test.
+ */
+
+typedef struct s_ptr_slot
+{
+	uint64_t key; /* pointer from the trace; 0 = empty */
+	void *live;	  /* pointer returned during the replay */
+} t_ptr_slot;
+
+typedef struct s_ptr_map
+{
+	t_ptr_slot *slots;
+	size_t mask;
+	size_t bytes;
+} t_ptr_map;
+
+static void *map_anon(size_t bytes)
+{
+	void *p = mmap(NULL, bytes ? bytes : 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return p == MAP_FAILED ? NULL : p;
+}
+
+/* ---------------- Trace pointer -> live pointer map ---------------- */
+
+static size_t ptr_hash(uint64_t key, size_t mask)
+{
+	return (size_t)(((key >> 4) * 0x9e3779b97f4a7c15ULL) >> 20) & mask;
+}
+
+static int map_init(t_ptr_map *m, size_t max_live)
+{
+	size_t cap = 1024;
+	while (cap < max_live * 2)
+		cap <<= 1;
+	m->bytes = cap * sizeof(t_ptr_slot);
+	m->slots = map_anon(m->bytes);
+	m->mask = cap - 1;
+	return m->slots ? 0 : -1;
+}
+
+static t_ptr_slot *map_find(t_ptr_map *m, uint64_t key)
+{
+	size_t i = ptr_hash(key, m->mask);
+	while (m->slots[i].key && m->slots[i].key != key)
+		i = (i + 1) & m->mask;
+	return &m->slots[i];
+}
+
+static void map_put(t_ptr_map *m, uint64_t key, void *live)
+{
+	t_ptr_slot *s = map_find(m, key);
+	s->key = key;
+	s->live = live;
+}
+
+/* Backward-shift deletion: no tombstones, probe chains stay short. */
+static void map_erase(t_ptr_map *m, t_ptr_slot *s)
+{
+	size_t i = (size_t)(s - m->slots);
+	size_t j = i;
+	while (1)
+	{
+		j = (j + 1) & m->mask;
+		if (!m->slots[j].key)
+			break;
+		size_t home = ptr_hash(m->slots[j].key, m->mask);
+		if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j)))
+		{
+			m->slots[i] = m->slots[j];
+			i = j;
+		}
+	}
+	m->slots[i].key = 0;
+	m->slots[i].live = NULL;
+}
+
+/* ---------------- Loading ---------------- */
+
+static int load_file(const char *path, t_trace_record *dst, size_t *n, size_t cap)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	t_trace_header h;
+	if (read(fd, &h, sizeof(h)) != (ssize_t)sizeof(h) || h.magic != MALLOC_TRACE_MAGIC ||
+		h.record_size != sizeof(t_trace_record))
+	{
+		close(fd);
+		return -1;
+	}
+	size_t want = h.count;
+	if (*n + want > cap)
+		want = cap - *n;
+	size_t bytes = want * sizeof(t_trace_record);
+	ssize_t got = pread(fd, dst + *n, bytes, (off_t)MALLOC_TRACE_HEADER_SIZE);
+	close(fd);
+	if (got < 0)
+		return -1;
+	*n += (size_t)got / sizeof(t_trace_record);
+	return 0;
+}
+
+static int cmp_record(const void *a, const void *b)
+{
+	const t_trace_record *x = a, *y = b;
+	if (x->ts != y->ts)
+		return x->ts < y->ts ? -1 : 1;
+	return (x < y) ? -1 : (x > y); /* files are loaded in order: keep it for ties */
+}
+
+static size_t count_records(int files, char **paths)
+{
+	size_t total = 0;
+	for (int i = 0; i < files; ++i)
+	{
+		int fd = open(paths[i], O_RDONLY);
+		t_trace_header h;
+		if (fd >= 0 && read(fd, &h, sizeof(h)) == (ssize_t)sizeof(h) && h.magic == MALLOC_TRACE_MAGIC)
+			total += h.count;
+		if (fd >= 0)
+			close(fd);
+	}
+	return total;
+}
+
+/* ---------------- Measurement helpers ---------------- */
+
+static long status_kb(const char *field)
+{
+	char buf[4096];
+	int fd = open("/proc/self/status", O_RDONLY);
+	if (fd < 0)
+		return -1;
+	ssize_t n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+	buf[n] = '\0';
+	char *p = strstr(buf, field);
+	return p ? strtol(p + strlen(field), NULL, 10) : -1;
+}
+
+/* Reset VmHWM so the peak only covers the replay (Linux >= 4.0). */
+static void reset_peak_rss(void)
+{
+	int fd = open("/proc/self/clear_refs", O_WRONLY);
+	if (fd < 0)
+		return;
+	if (write(fd, "5", 1) != 1)
+		fprintf(stderr, "bench_replay: cannot reset peak RSS\n");
+	close(fd);
+}
+
+/* Write one byte per page, as the program that owned the block would have. */
+static void touch(void *p, size_t sz)
+{
+	char *c = p;
+	for (size_t off = 0; off < sz; off += 4096)
+		c[off] = 1;
+}
+
+/* ---------------- Replay ---------------- */
+
+typedef struct s_replay
+{
+	t_bench_hist hist[4]; /* indexed by t_trace_op */
+	size_t skipped; /* free/realloc of a pointer the trace never returned */
+	size_t failed;	/* allocation returned NULL */
+	double seconds;
+} t_replay;
+
+static void replay(const t_trace_record *recs, size_t n, t_ptr_map *map, t_replay *out)
+{
+	double t0 = bench_now_sec();
+	for (size_t i = 0; i < n; ++i)
+	{
+		const t_trace_record *r = &recs[i];
+		uint64_t c0, c1;
+		if (r->op == MALLOC_TRACE_MALLOC)
+		{
+			c0 = malloc_cycles();
+			void *p = malloc(r->size);
+			c1 = malloc_cycles();
+			if (p && r->result)
+			{
+				touch(p, r->size);
+				map_put(map, r->result, p);
+			}
+			else if (!p && r->size)
+				out->failed++;
+		}
+		else if (r->op == MALLOC_TRACE_FREE)
+		{
+			t_ptr_slot *s = map_find(map, r->ptr);
+			if (!s->key)
+			{
+				out->skipped++;
+				continue;
+			}
+			void *live = s->live;
+			map_erase(map, s);
+			c0 = malloc_cycles();
+			free(live);
+			c1 = malloc_cycles();
+		}
+		else if (r->op == MALLOC_TRACE_REALLOC)
+		{
+			void *old = NULL;
+			if (r->ptr)
+			{
+				t_ptr_slot *s = map_find(map, r->ptr);
+				if (!s->key)
+					out->skipped++; /* unknown block: replay as malloc */
+				else
+				{
+					old = s->live;
+					map_erase(map, s);
+				}
+			}
+			c0 = malloc_cycles();
+			void *p = realloc(old, r->size);
+			c1 = malloc_cycles();
+			if (p && r->result)
+			{
+				touch(p, r->size);
+				map_put(map, r->result, p);
+			}
+			else if (!p && r->size)
+				out->failed++;
+		}
+		else
+			continue;
+		bench_hist_add(&out->hist[r->op], c1 - c0);
+	}
+	out->seconds = bench_now_sec() - t0;
+}
+
+static void report(const char *label, const t_bench_hist *h, double tpn)
+{
+	if (!h->count)
+		return;
+	printf("%-8s n=%-10llu mean=%.0f p50=%.0f p90=%.0f p99=%.0f p99.9=%.0f max=%.0f ns\n", label,
+		   (unsigned long long)h->count, (double)h->sum / (double)h->count / tpn,
+		   bench_hist_percentile(h, 0.50) / tpn, bench_hist_percentile(h, 0.90) / tpn,
+		   bench_hist_percentile(h, 0.99) / tpn, bench_hist_percentile(h, 0.999) / tpn, (double)h->max / tpn);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s trace_file [trace_file...]\n"
+						"  Files come from a `make TRACE=1` build run with %s=<prefix>.\n",
+				argv[0], MALLOC_TRACE_ENV);
+		return 1;
+	}
+	size_t cap = count_records(argc - 1, argv + 1);
+	t_trace_record *recs = map_anon(cap * sizeof(t_trace_record));
+	size_t n = 0;
+	if (!recs)
+		return 1;
+	for (int i = 1; i < argc; ++i)
+		if (load_file(argv[i], recs, &n, cap) != 0)
+			fprintf(stderr, "bench_replay: skipping %s (not a trace file)\n", argv[i]);
+	qsort(recs, n, sizeof(*recs), cmp_record);
+
+	t_ptr_map map;
+	t_replay *res = map_anon(sizeof(t_replay));
+	if (!res || map_init(&map, n) != 0)
+		return 1;
+	double tpn = bench_ticks_per_ns();
+	t_bench_perf perf;
+	bench_perf_open(&perf);
+	reset_peak_rss();
+	long base_kb = status_kb("VmRSS:");
+	bench_perf_start(&perf);
+	replay(recs, n, &map, res);
+	bench_perf_stop(&perf);
+	long peak_kb = status_kb("VmHWM:");
+
+	size_t ops = res->hist[MALLOC_TRACE_MALLOC].count + res->hist[MALLOC_TRACE_FREE].count +
+				 res->hist[MALLOC_TRACE_REALLOC].count;
+	double alloc_sec = 0;
+	for (int k = 1; k < 4; ++k)
+		alloc_sec += (double)res->hist[k].sum / tpn / 1e9;
+	printf("records=%zu replayed=%zu skipped=%zu failed=%zu\n", n, ops, res->skipped, res->failed);
+	printf("wall=%.6f s allocator=%.6f s throughput=%.0f ops/s\n", res->seconds, alloc_sec,
+		   alloc_sec > 0 ? (double)ops / alloc_sec : 0.0);
+	printf("peak_rss=%ld KiB (+%ld KiB during the replay)\n", peak_kb, peak_kb - base_kb);
+	report("malloc", &res->hist[MALLOC_TRACE_MALLOC], tpn);
+	report("free", &res->hist[MALLOC_TRACE_FREE], tpn);
+	report("realloc", &res->hist[MALLOC_TRACE_REALLOC], tpn);
+	/* The whole replay loop: map lookups and page touching are included. */
+	bench_perf_print(&perf, "perf    ", (double)ops);
+	bench_perf_close(&perf);
+	return 0;
+}
@@ -0,0 +1,180 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   bench_rss.c                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 18:52:17 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/19 18:52:17 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+/*
+ * Memory overhead per object size: a population of same-size objects is
+ * allocated and fully written in a fresh child process, and the growth of the
+ * resident set is divided by the bytes requested.
+ * CSV: size,class,allocator,count,requested_bytes,rss_bytes,rss_per_requested,
+ *      overhead_per_object
+ * The sizes straddle the TINY/SMALL/LARGE boundaries of this allocator
+ * (malloc_tiny_max / malloc_small_max, the historical 128 / 4096 when the
+ * bench runs on libc), so the header cost, the zone granularity and the LARGE
+ * page rounding each show up as a step.
+ */
+
+#define DEFAULT_TARGET_MB 32
+#define MAX_OBJECTS (1UL << 20)
+#define MIN_OBJECTS 16
+
+/* Present in libft_malloc only. */
+extern size_t malloc_tiny_max(void) __attribute__((weak));
+extern size_t malloc_small_max(void) __attribute__((weak));
+
+static long page_size(void)
+{
+	long ps = sysconf(_SC_PAGESIZE);
+	return ps > 0 ? ps : 4096;
+}
+
+/* Resident bytes from /proc/self/statm (second field, in pages). */
+static long resident_bytes(void)
+{
+	char buf[256];
+	int fd = open("/proc/self/statm", O_RDONLY);
+	if (fd < 0)
+		return -1;
+	ssize_t n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+	buf[n] = '\0';
+	char *p = strchr(buf, ' ');
+	return p ? strtol(p + 1, NULL, 10) * page_size() : -1;
+}
+
+static const char *size_class(size_t sz, size_t tiny, size_t small)
+{
+	if (sz <= tiny)
+		return "tiny";
+	return sz <= small ? "small" : "large";
+}
+
+/* Child side: allocate `count` objects of `sz` bytes, write every byte, and
+ * send the resident growth back through `out`. The pointer array comes from
+ * mmap and is resident before the baseline read. */
+static void measure(size_t sz, size_t count, int out)
+{
+	void **objs = mmap(NULL, count * sizeof(void *), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	long delta = -1;
+	if (objs != MAP_FAILED)
+	{
+		memset(objs, 0, count * sizeof(void *));
+		long before = resident_bytes();
+		size_t i = 0;
+		for (; i < count; ++i)
+		{
+			objs[i] = malloc(sz);
+			if (!objs[i])
+				break;
+			memset(objs[i], 0xA5, sz);
+		}
+		long after = resident_bytes();
+		if (i == count && before >= 0 && after >= 0)
+			delta = after - before;
+	}
+	if (write(out, &delta, sizeof(delta)) != (ssize_t)sizeof(delta))
+		_exit(1);
+	_exit(0);
+}
+
+static void run_size(size_t sz, size_t target, size_t tiny, size_t small)
+{
+	size_t count = target / sz;
+	if (count > MAX_OBJECTS)
+		count = MAX_OBJECTS;
+	if (count < MIN_OBJECTS)
+		count = MIN_OBJECTS;
+	int fds[2];
+	if (pipe(fds) != 0)
+		return;
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(fds[0]);
+		measure(sz, count, fds[1]);
+	}
+	close(fds[1]);
+	long rss = -1;
+	if (pid < 0 || read(fds[0], &rss, sizeof(rss)) != (ssize_t)sizeof(rss))
+		rss = -1;
+	close(fds[0]);
+	if (pid > 0)
+		waitpid(pid, NULL, 0);
+	size_t requested = sz * count;
+	if (rss < 0)
+	{
+		printf("%zu,%s,%s,%zu,%zu,,,\n", sz, size_class(sz, tiny, small), bench_allocator(), count, requested);
+		return;
+	}
+	printf("%zu,%s,%s,%zu,%zu,%ld,%.3f,%.1f\n", sz, size_class(sz, tiny, small), bench_allocator(), count,
+		   requested, rss, (double)rss / (double)requested, ((double)rss - (double)requested) / (double)count);
+}
+
+int main(int argc, char **argv)
+{
+	size_t target_mb = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_TARGET_MB;
+	if (!target_mb)
+	{
+		fprintf(stderr, "Usage: %s [megabytes_per_size] (default %d)\n", argv[0], DEFAULT_TARGET_MB);
+		return 1;
+	}
+	size_t tiny = malloc_tiny_max ? malloc_tiny_max() : 128;
+	size_t small = malloc_small_max ? malloc_small_max() : 4096;
+	size_t ps = (size_t)page_size();
+	size_t sizes[] = {1,
+					  8,
+					  16,
+					  24,
+					  32,
+					  48,
+					  64,
+					  96,
+					  tiny - 16,
+					  tiny,
+					  tiny + 1,
+					  tiny + 16,
+					  256,
+					  512,
+					  1024,
+					  2048,
+					  small - 16,
+					  small,
+					  small + 1,
+					  small + 16,
+					  2 * ps - 64,
+					  2 * ps,
+					  2 * ps + 1,
+					  16384,
+					  65536,
+					  131072,
+					  1UL << 20};
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+		run_size(sizes[i], target_mb << 20, tiny, small);
+	return 0;
+}
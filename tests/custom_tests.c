@@ -6,7 +6,7 @@
 /*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2025/09/24 15:52:57 by tamigore          #+#    #+#             */
-/*   Updated: 2025/09/27 18:25:34 by tamigore         ###   ########.fr       */
+/*   Updated: 2026/10/20 15:12:40 by tamigore         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
@@ -17,6 +17,9 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h> // for memset
+#ifdef MALLOC_PERCPU
+#include "malloc_percpu.h"
+#endif
 
 // Local lightweight asserts (independent of main harness counters)
 static void ct_fail(const char *name, const char *msg) { fprintf(stderr, "[FAIL] %s: %s\n", name, msg); }
@@ -128,33 +131,341 @@ static void test_split_reuse(void)
 	free(b);
 }
 
+// Per-CPU cached objects back to the heap, where they are parked on the quick lists.
+static void cache_drain(void)
+{
+#ifdef MALLOC_PERCPU
+	malloc_percpu_drain();
+#endif
+}
+
+static void quick_flush(void)
+{
+	cache_drain();
+	malloc_lock();
+	malloc_quick_flush();
+	malloc_unlock();
+}
+
+// Whether one free TINY/SMALL block spans the payloads in [lo, hi).
+static int free_block_spans(uintptr_t lo, uintptr_t hi)
+{
+	for (t_zone *z = g_zones; z; z = z->next)
+		for (t_block *b = z->type == ZONE_LARGE ? NULL : z->blocks; b; b = b->next)
+			if (b->free && (uintptr_t)block_payload(b) <= lo && (uintptr_t)block_payload(b) + b->size >= hi)
+				return 1;
+	return 0;
+}
+
+// Three blocks of `size` that follow each other in memory: the holes earlier
+// tests left behind (and per-CPU refills) can hand out scattered ones.
+static int neighbours(size_t size, char **a, char **b, char **c)
+{
+	enum { N = 32 };
+	char *p[N];
+	size_t n = 0;
+	*a = *b = *c = NULL;
+	while (n < N && (p[n] = malloc(size)))
+		n++;
+	for (size_t i = 0; i < n && !*a; ++i)
+		for (size_t j = 0; j < n && !*a; ++j)
+			for (size_t k = 0; k < n && !*a; ++k)
+				if ((uintptr_t)p[i] + ptr_to_block(p[i])->size == (uintptr_t)ptr_to_block(p[j]) &&
+					(uintptr_t)p[j] + ptr_to_block(p[j])->size == (uintptr_t)ptr_to_block(p[k]))
+				{
+					*a = p[i];
+					*b = p[j];
+					*c = p[k];
+				}
+	for (size_t i = 0; i < n; ++i)
+		if (p[i] != *a && p[i] != *b && p[i] != *c)
+			free(p[i]);
+	return *a != NULL;
+}
+
 static void test_coalesce_chain(void)
 {
 	size_t s = 64;
-	void *a = malloc(s), *b = malloc(s), *c = malloc(s);
-	ct_assert(a && b && c, "coalesce chain", "abc");
-	void *addr = a;
+	quick_flush(); // settle the blocks earlier tests left parked
+	char *a, *b, *c;
+	ct_assert(neighbours(s, &a, &b, &c), "coalesce chain", "abc");
+	if (!a)
+		return;
+	volatile uintptr_t lo2 = (uintptr_t)a, hi2 = (uintptr_t)b + s;
+	volatile uintptr_t lo3 = lo2, hi3 = (uintptr_t)c + s;
 	free(b);
 	free(a);
+	quick_flush(); // freed blocks are cached or parked unmerged until then
+	ct_assert(free_block_spans(lo2, hi2), "coalesce chain", "a and b merged");
+#ifndef MALLOC_PERCPU
 	void *d = malloc(2 * s);
 	if (d)
 	{
 		if (2 * s > TINY_MAX)
-			ct_assert(d != addr, "coalesce chain", "classify");
+			ct_assert(d != (void *)lo2, "coalesce chain", "classify");
 		else
-			ct_assert(d == addr, "coalesce chain", "reuse2");
+			ct_assert(d == (void *)lo2, "coalesce chain", "reuse2");
 	}
 	free(d);
+#endif
 	free(c);
+	quick_flush();
+	ct_assert(free_block_spans(lo3, hi3), "coalesce chain", "a, b and c merged");
+#ifndef MALLOC_PERCPU
 	void *e = malloc(3 * s);
 	if (e)
 	{
 		if (3 * s > TINY_MAX)
-			ct_assert(e != addr, "coalesce chain", "classify");
+			ct_assert(e != (void *)lo3, "coalesce chain", "classify");
 		else
-			ct_assert(e == addr, "coalesce chain", "reuse3");
+			ct_assert(e == (void *)lo3, "coalesce chain", "reuse3");
+	}
+	free(e);
+#endif
+}
+
+static void test_quick_lists(void)
+{
+	enum { N = MALLOC_QUICK_LIMIT + 1 };
+	static void *many[N];
+	quick_flush();
+	void *a = malloc(64), *b = malloc(64);
+	ct_assert(a && b, "quick lists", "allocs");
+	volatile uintptr_t pa = (uintptr_t)a, pb = (uintptr_t)b; // opaque to -Wuse-after-free
+	free(a);
+	free(b);
+	cache_drain(); // per-CPU builds: released in cache order
+	t_block *ba = ptr_to_block((void *)pa), *bb = ptr_to_block((void *)pb);
+	ct_assert((ba->flags & BLOCK_F_QUICK) && (bb->flags & BLOCK_F_QUICK), "quick lists", "parked");
+	ct_assert(!ba->free && !bb->free && ba->size == 64, "quick lists", "not merged");
+	free((void *)pa); // double free of a parked block is ignored
+	void *c = malloc(64), *d = malloc(64);
+#ifndef MALLOC_PERCPU
+	ct_assert((uintptr_t)c == pb && (uintptr_t)d == pa, "quick lists", "taken back LIFO");
+#endif
+	ct_assert(!(ba->flags & BLOCK_F_QUICK) && !(bb->flags & BLOCK_F_QUICK), "quick lists", "unparked");
+	void *e = malloc(64);
+	ct_assert(e != d, "quick lists", "double free not parked twice");
+	free(e);
+	for (size_t i = 0; i < N; ++i)
+		many[i] = malloc(32);
+	for (size_t i = 0; i < N; ++i)
+		free(many[i]);
+	volatile uintptr_t first = (uintptr_t)many[0];
+	ct_assert(!(ptr_to_block((void *)first)->flags & BLOCK_F_QUICK), "quick lists", "flushed over the limit");
+	free(c);
+	free(d);
+	quick_flush();
+	ct_assert(ba->free && bb->free, "quick lists", "released on flush");
+}
+
+static void test_bins_zone_churn(void)
+{
+	void *y = malloc(64), *x = malloc(64), *guard = malloc(64);
+	ct_assert(y && x && guard, "bins zone churn", "allocs");
+	free(x);						   // x goes to its bin
+	void *big = malloc(SMALL_MAX + 1); // LARGE zone becomes the g_zones head
+	free(y);						   // y absorbs x
+	free(big);						   // ... and is unlinked again
+	void *p = malloc(64);
+	ct_assert(p && malloc_debug_valid(p), "bins zone churn", "no stale bin entry handed out");
+	free(p);
+	free(guard);
+}
+
+static void count_block(const t_block *b, void *arg)
+{
+	(void)b;
+	(*(size_t *)arg)++;
+}
+
+static size_t small_tree_blocks(void)
+{
+	size_t n = 0;
+	malloc_bin_tree_walk(ZONE_SMALL, count_block, &n);
+	return n;
+}
+
+static void test_bin_tree(void)
+{
+	enum { DRAIN = 4096, RUN = 9, TRIES = 3 };
+	static void *drain[DRAIN];
+	size_t drained = 0;
+	quick_flush(); // parked blocks would merge into the tree on the first miss
+	// Empty the SMALL tree so the next SMALL_MAX blocks are appended in a row.
+	while (small_tree_blocks() && drained < DRAIN)
+		drain[drained++] = malloc(SMALL_MAX);
+	ct_assert(!small_tree_blocks(), "bin tree", "drained");
+	// Layout g0 a0 a1 a2 g1 b0 g2 c0 g3; retried if a zone ends inside it.
+	void *runs[TRIES][RUN] = {{0}};
+	void **p = NULL;
+	for (int t = 0; t < TRIES && !p; ++t)
+	{
+		int adjacent = 1;
+		for (int i = 0; i < RUN; ++i)
+			runs[t][i] = malloc(SMALL_MAX);
+		for (int i = 0; i + 1 < RUN; ++i)
+			adjacent &= runs[t][i] && runs[t][i + 1] && ptr_to_block(runs[t][i])->next == ptr_to_block(runs[t][i + 1]);
+		if (adjacent)
+			p = runs[t];
+	}
+	ct_assert(p != NULL, "bin tree", "adjacent blocks");
+	if (p)
+	{
+		char *a0 = p[1], *b0 = p[5], *c0 = p[7];
+		free(b0);
+		free(c0);
+		free(p[1]);
+		free(p[2]);
+		free(p[3]); // A = a0..a2, freed last
+		ct_assert(small_tree_blocks() == 3, "bin tree", "free blocks indexed");
+		p[5] = malloc(SMALL_MAX);
+		ct_assert(p[5] == b0, "bin tree", "best fit, lowest address first");
+		p[7] = malloc(SMALL_MAX);
+		ct_assert(p[7] == c0, "bin tree", "best fit");
+		p[1] = malloc(SMALL_MAX);
+		ct_assert(p[1] == a0, "bin tree", "larger block split");
+		p[2] = p[3] = NULL;
+		ct_assert(small_tree_blocks() == 1 && ptr_to_block(p[1])->next->free, "bin tree", "remainder indexed");
+	}
+	for (int t = 0; t < TRIES; ++t)
+		for (int i = 0; i < RUN; ++i)
+			free(runs[t][i]);
+	while (drained)
+		free(drain[--drained]);
+}
+
+static void test_zone_growth(void)
+{
+	enum { MAX_PTRS = 4096, NEW_ZONES = 3 };
+	static void *ptrs[MAX_PTRS];
+	t_zone *seen[NEW_ZONES] = {0};
+	size_t n = 0, zones = 0;
+	// Existing SMALL zones fill up first; a fresh zone holds only the new block.
+	while (n < MAX_PTRS && zones < NEW_ZONES)
+	{
+		ptrs[n] = malloc(SMALL_MAX);
+		if (!ptrs[n])
+			break;
+		t_block *b = ptr_to_block(ptrs[n++]);
+		if (b->zone->blocks == b && !b->next)
+			seen[zones++] = b->zone;
+	}
+	ct_assert(zones == NEW_ZONES, "zone growth", "new SMALL zones");
+#ifdef MALLOC_HUGEPAGE
+	size_t granule = MALLOC_HUGE_PAGE; // sizes round up to huge pages: equal zones are fine
+#else
+	size_t granule = malloc_pagesize();
+#endif
+	for (size_t i = 1; i < zones; ++i)
+		ct_assert(seen[i]->capacity > seen[i - 1]->capacity || seen[i]->capacity + seen[i]->data_offset >= MALLOC_ZONE_MAX_SIZE ||
+					  (granule > malloc_pagesize() && seen[i]->capacity == seen[i - 1]->capacity),
+				  "zone growth", "each zone larger up to the maximum");
+	for (size_t i = 0; i < zones; ++i)
+		ct_assert(seen[i]->capacity + seen[i]->data_offset <= ALIGN_UP(MALLOC_ZONE_MAX_SIZE, granule),
+				  "zone growth", "bounded by MALLOC_ZONE_MAX_SIZE");
+	while (n)
+		free(ptrs[--n]);
+	void *p = malloc(SMALL_MAX);
+	ct_assert(p && malloc_debug_valid(p), "zone growth", "reuse after freeing the zones");
+	free(p);
+}
+
+static void test_reserve(void)
+{
+	void *t = malloc(16), *s = malloc(SMALL_MAX), *l = malloc(SMALL_MAX + 1);
+	ct_assert(t && s && l, "reserve", "allocs");
+	if (!g_reserve.base)
+	{
+		ct_assert(!malloc_reserve_owns(t), "reserve", "no reservation: nothing owned");
+		free(t);
+		free(s);
+		free(l);
+		return; // address space limited: zones fell back to mmap
+	}
+	ct_assert(malloc_reserve_owns(t) && malloc_reserve_owns(s), "reserve", "TINY/SMALL zones inside");
+	ct_assert(!malloc_reserve_owns(l), "reserve", "LARGE mapped on its own");
+	// Zones are carved upwards: the most recent TINY/SMALL zone is the highest.
+	t_zone *prev = NULL;
+	int ordered = 1;
+	for (t_zone *z = g_zones; z; z = z->next)
+		if (z->type != ZONE_LARGE && malloc_reserve_owns(z))
+		{
+			if (prev && z > prev)
+				ordered = 0;
+			prev = z;
+		}
+	ct_assert(ordered, "reserve", "zones in address order");
+	ct_assert(g_reserve.top <= g_reserve.end && (size_t)(g_reserve.top - g_reserve.base) % malloc_pagesize() == 0,
+			  "reserve", "committed pages");
+#ifdef MALLOC_HUGEPAGE
+	ct_assert((uintptr_t)g_reserve.base % MALLOC_HUGE_PAGE == 0 && (size_t)(g_reserve.top - g_reserve.base) % MALLOC_HUGE_PAGE == 0,
+			  "reserve", "huge-page aligned zones");
+	void *h = malloc(MALLOC_HUGE_PAGE);
+	t_zone *hz = h ? ptr_to_block(h)->zone : NULL;
+	ct_assert(hz && (uintptr_t)h % MALLOC_HUGE_PAGE == 0 && hz->capacity % MALLOC_HUGE_PAGE == 0,
+			  "reserve", "huge-page aligned LARGE block");
+	free(h);
+#endif
+	free(t);
+	free(s);
+	free(l);
+}
+
+static void test_large_layout(void)
+{
+	size_t ps = malloc_pagesize();
+	size_t sizes[] = {16 * ps, SMALL_MAX + 1, 3 * ps + 100};
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+	{
+		char *p = malloc(sizes[i]);
+		ct_assert(p != NULL, "large layout", "alloc");
+		if (!p)
+			continue;
+		t_block *b = ptr_to_block(p);
+		ct_assert((uintptr_t)p % ps == 0, "large layout", "page-aligned payload");
+		ct_assert(b->zone && b->zone->type == ZONE_LARGE && block_payload(b) == p, "large layout", "out-of-line header");
+#ifndef MALLOC_HUGEPAGE
+		ct_assert(b->zone && b->zone->capacity == ALIGN_UP(sizes[i], ps), "large layout", "maps exactly the rounded size");
+#endif
+		ct_assert(malloc_debug_valid(p) && malloc_debug_requested(p) == sizes[i], "large layout", "debug helpers");
+		memset(p, 0x5A, sizes[i]);
+		ct_assert(p[0] == 0x5A && p[sizes[i] - 1] == 0x5A, "large layout", "whole payload usable");
+		volatile uintptr_t addr = (uintptr_t)p; // opaque to -Wuse-after-free
+		free(p);
+		ct_assert(malloc_large_find((void *)addr) == NULL, "large layout", "unregistered on free");
 	}
+}
+
+static void test_medium_runs(void)
+{
+	size_t run = 64 * 1024;
+	char *a = malloc(run), *b = malloc(run), *c = malloc(run);
+	ct_assert(a && b && c, "medium runs", "allocs");
+	if (!a || !b || !c)
+		return;
+	t_large *ra = (t_large *)ptr_to_block(a)->zone;
+	ct_assert(ra->chunk && ra->chunk == ((t_large *)ptr_to_block(c)->zone)->chunk, "medium runs", "carved from one chunk");
+	ct_assert(b == a + run && c == b + run, "medium runs", "adjacent page runs");
+	memset(a, 0x5a, run); // what a stale b would read as its header
+	volatile uintptr_t stale_a = (uintptr_t)a, stale_b = (uintptr_t)b; // opaque to -Wuse-after-free
+	free(b);
+	free((void *)stale_b); // double free of a free run: ignored
+	free(a);			   // merges with b
+	free((void *)stale_b); // no run starts there any more: ignored
+	free((void *)stale_a); // heads the merged free run: ignored
+	char *d = malloc(2 * run);
+	ct_assert(d == a, "medium runs", "merged run reused");
+	char *e = malloc(2 * run);
+	ct_assert(e && e != d, "medium runs", "double frees left the run lists intact");
 	free(e);
+	char *big = malloc(MALLOC_MEDIUM_MAX + 1);
+	ct_assert(big && !((t_large *)ptr_to_block(big)->zone)->chunk, "medium runs", "above MALLOC_MEDIUM_MAX: own mapping");
+	free(big);
+	volatile uintptr_t addr = (uintptr_t)c; // opaque to -Wuse-after-free
+	free(d);
+	free(c);
+	ct_assert(malloc_large_find((void *)addr) == NULL, "medium runs", "empty chunk unmapped");
 }
 
 static void test_realloc_shrink(void)
@@ -169,6 +480,436 @@ static void test_realloc_shrink(void)
 	free(q);
 }
 
+#ifdef MALLOC_PERCPU
+static void test_percpu_reuse(void)
+{
+	void *a = malloc(48);
+	ct_assert(a != NULL, "percpu reuse", "a");
+	free(a);
+	void *b = malloc(40); // same 48-byte class
+	ct_assert(b == a, "percpu reuse", "cached block returned");
+	ct_assert(malloc_debug_requested(b) == 40, "percpu reuse", "requested updated");
+	free(b);
+	void *c = malloc(48), *d = malloc(48);
+	ct_assert(c && c != d, "percpu reuse", "no duplicate hand-out");
+	free(c);
+	free(d);
+}
+
+static void test_percpu_magazines(void)
+{
+	enum { N = 4096, SIZE = 700 }; // a class no other test uses
+	static uintptr_t objs[N];	   // addresses: opaque to -Wuse-after-free
+	int distinct = 1;
+	for (size_t i = 0; i < N; ++i)
+	{
+		objs[i] = (uintptr_t)malloc(SIZE);
+		if (!objs[i])
+		{
+			ct_fail("percpu magazines", "alloc");
+			return;
+		}
+		distinct &= !(ptr_to_block((void *)objs[i])->flags & BLOCK_F_CACHED);
+		*(size_t *)objs[i] = i;
+	}
+	for (size_t i = 0; i < N; ++i)
+		distinct &= *(size_t *)objs[i] == i;
+	ct_assert(distinct, "percpu magazines", "each block handed out once");
+	for (size_t i = 0; i < N; ++i)
+		free((void *)objs[i]);
+	size_t cached = 0;
+	for (size_t i = 0; i < N; ++i)
+		cached += (ptr_to_block((void *)objs[i])->flags & BLOCK_F_CACHED) != 0;
+	long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+	ct_assert(cached > PERCPU_DEPTH, "percpu magazines", "full magazines kept in the depot");
+	ct_assert(cached <= (size_t)ncpu * PERCPU_DEPTH + PERCPU_DEPOT_MAGS * PERCPU_MAG_SIZE, "percpu magazines",
+			  "cached objects bounded");
+	void *p = malloc(SIZE);
+	int ours = 0;
+	for (size_t i = 0; i < N; ++i)
+		ours |= (uintptr_t)p == objs[i];
+	ct_assert(ours && !(ptr_to_block(p)->flags & BLOCK_F_CACHED), "percpu magazines", "cached block reused");
+	free(p);
+}
+#endif
+
+static void test_lock_stats(void)
+{
+	t_malloc_lock_stats st[2];
+	size_t n = malloc_lock_stats(st, 2);
+#ifdef MALLOC_LOCK_STATS
+#ifdef MALLOC_PERCPU
+	ct_assert(n == 2 && !strcmp(st[0].name, "global") && !strcmp(st[1].name, "depot"), "lock stats",
+			  "global and depot locks");
+	// Fill and drain more than the cache holds: magazines move through the depot.
+	uint64_t depot_before = st[1].acquisitions;
+	void *volatile objs[4 * PERCPU_DEPTH]; // volatile: -O2 may drop malloc/free pairs
+	for (size_t i = 0; i < sizeof(objs) / sizeof(objs[0]); ++i)
+		objs[i] = malloc(64);
+	for (size_t i = 0; i < sizeof(objs) / sizeof(objs[0]); ++i)
+		free(objs[i]);
+	malloc_lock_stats(st, 2);
+	ct_assert(st[1].acquisitions > depot_before, "lock stats", "depot acquisitions counted");
+#else
+	ct_assert(n == 1, "lock stats", "one instrumented lock");
+#endif
+	uint64_t before = st[0].acquisitions;
+	void *volatile l = malloc(SMALL_MAX + 1); // volatile: -O2 may drop a malloc/free pair
+	free(l);								  // LARGE path always takes the mutex
+	malloc_lock_stats(st, 2);
+	ct_assert(st[0].acquisitions >= before + 2, "lock stats", "acquisitions counted");
+	ct_assert(st[0].contended <= st[0].acquisitions, "lock stats", "contended <= acquisitions");
+	uint64_t holds = 0;
+	for (size_t k = 0; k < MALLOC_LOCK_HIST_BUCKETS; ++k)
+		holds += st[0].hold_hist[k];
+	ct_assert(holds + 1 >= st[0].acquisitions, "lock stats", "hold histogram filled");
+#else
+	ct_assert(n == 0, "lock stats", "disabled build reports no locks");
+#endif
+}
+
+static void test_stats_api(void)
+{
+	static t_malloc_stats before, after;
+	ct_assert(malloc_stats_get(NULL) == -1, "stats api", "NULL rejected");
+	// volatile: -O2 may drop allocations that are only freed again
+	void *volatile keep = malloc(48);
+	malloc_stats_get(&before);
+	void *volatile p[3] = {malloc(40), malloc(48), malloc(33)}; // all in the 48-byte class
+	void *volatile big = malloc(SMALL_MAX + 1);
+	malloc_stats_get(&after);
+	ct_assert(after.zones[ZONE_TINY] >= 1 && after.zones[ZONE_LARGE] >= 1, "stats api", "zone counts");
+	ct_assert(after.mapped > before.mapped, "stats api", "LARGE zone mapped");
+	ct_assert(after.resident <= after.mapped && after.dirty <= after.resident, "stats api", "resident/dirty bounds");
+#ifdef MALLOC_STATS
+	size_t c48 = malloc_stats_class(48);
+	ct_assert(after.classes[c48].allocs - before.classes[c48].allocs == 3, "stats api", "class allocs");
+	ct_assert(after.classes[c48].live_objects - before.classes[c48].live_objects == 3, "stats api", "live objects");
+	ct_assert(after.types[ZONE_LARGE].zone_allocs - before.types[ZONE_LARGE].zone_allocs == 1, "stats api", "large zone alloc");
+	const t_malloc_class_stats *t = &after.types[ZONE_TINY];
+	ct_assert(t->allocs == t->bin_hits + t->append_allocs + t->zone_allocs + t->cache_hits, "stats api", "paths add up");
+#else
+	ct_assert(after.types[ZONE_TINY].allocs == 0, "stats api", "counters off without STATS");
+#endif
+	for (int i = 0; i < 3; ++i)
+		free(p[i]);
+	free(big);
+	free(keep);
+#ifdef MALLOC_STATS
+	malloc_stats_get(&after);
+	ct_assert(after.classes[c48].frees - before.classes[c48].frees == 4, "stats api", "class frees");
+	ct_assert(after.types[ZONE_LARGE].live_objects == before.types[ZONE_LARGE].live_objects, "stats api", "large live");
+#endif
+}
+
+static void test_profile_dump(void)
+{
+#ifdef MALLOC_PROFILE
+	malloc_profile_set_period(1); // mean gap of one byte: sample (almost) everything
+	void *volatile warm = malloc(8); // re-arms the per-thread counter; volatile so -O2 keeps it
+	void *p = malloc(100);
+	ct_assert(p && (ptr_to_block(p)->flags & BLOCK_F_SAMPLED), "profile dump", "block flagged");
+	ct_assert(malloc_profile_dump("/tmp/ft_malloc_test.heap") == 0, "profile dump", "dump written");
+	FILE *f = fopen("/tmp/ft_malloc_test.heap", "r");
+	char line[128] = {0};
+	ct_assert(f && fgets(line, sizeof(line), f) && !strncmp(line, "heap profile:", 13), "profile dump", "pprof header");
+	if (f)
+		fclose(f);
+	remove("/tmp/ft_malloc_test.heap");
+	malloc_profile_set_period(MALLOC_PROFILE_PERIOD);
+	free(p);
+	free(warm);
+#else
+	ct_assert(malloc_profile_dump("/tmp/ft_malloc_test.heap") == -1, "profile dump", "disabled build");
+#endif
+}
+
+static void test_show_ex(void)
+{
+	void *p = malloc(40);
+	void *volatile big = malloc(SMALL_MAX + 1); // volatile: -O2 may drop an unused allocation
+	ct_assert(show_alloc_mem_ex(1, (t_show_format)7) == -1, "show ex", "bad format rejected");
+	FILE *f = tmpfile();
+	ct_assert(f && show_alloc_mem_ex(fileno(f), SHOW_FORMAT_BINARY) == 0, "show ex", "binary written");
+	if (f)
+	{
+		rewind(f);
+		t_show_bin_header h = {0};
+		ct_assert(fread(&h, sizeof(h), 1, f) == 1 && h.magic == SHOW_BIN_MAGIC && h.version == SHOW_BIN_VERSION,
+				  "show ex", "binary header");
+		int found = 0, large = 0;
+		for (uint64_t z = 0; z < h.zone_count; ++z)
+		{
+			t_show_bin_zone zr;
+			if (fread(&zr, sizeof(zr), 1, f) != 1)
+				break;
+			large += (zr.type == ZONE_LARGE);
+			for (uint32_t k = 0; k < zr.block_count; ++k)
+			{
+				t_show_bin_block br;
+				if (fread(&br, sizeof(br), 1, f) != 1)
+					break;
+				if (br.address == (uintptr_t)p)
+					found = (br.size == 48 && br.requested == 40 && !(br.flags & SHOW_BLOCK_FREE));
+			}
+		}
+		ct_assert(found && large >= 1, "show ex", "binary records");
+		fclose(f);
+	}
+	f = tmpfile();
+	ct_assert(f && show_alloc_mem_ex(fileno(f), SHOW_FORMAT_JSON) == 0, "show ex", "json written");
+	if (f)
+	{
+		char needle[96], line[256];
+		int found = 0;
+		snprintf(needle, sizeof(needle), "{\"address\":\"%p\",\"size\":48,\"requested\":40,\"free\":false", p);
+		rewind(f);
+		while (fgets(line, sizeof(line), f))
+			found |= !strncmp(line, needle, strlen(needle));
+		ct_assert(found, "show ex", "json block");
+		fclose(f);
+	}
+	free(big);
+	free(p);
+}
+
+static void test_frag_api(void)
+{
+	// SMALL sizes above the per-CPU cache limit, so free() really bins the block.
+	void *a = malloc(2000), *b = malloc(2000), *c = malloc(2000);
+	void *volatile t = malloc(10); // volatile: -O2 may drop an unused allocation
+	void *volatile q = malloc(16); // parked on a quick list unless the per-CPU cache takes it
+	ct_assert(malloc_frag_get(NULL) == -1, "frag api", "NULL rejected");
+	free(b);
+	free(q);
+	t_malloc_frag *fr = mmap(NULL, sizeof(*fr), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ct_assert(fr != MAP_FAILED && malloc_frag_get(fr) == 0, "frag api", "report filled");
+	if (fr == MAP_FAILED)
+		return;
+	const t_malloc_frag_type *sm = &fr->types[ZONE_SMALL];
+	ct_assert(sm->free_blocks >= 1 && sm->largest_free >= 2000, "frag api", "free block seen");
+	uint64_t binned = 0;
+	for (size_t i = 0; i < MALLOC_FRAG_BINS; ++i)
+		if (!sm->bin_size[i] || sm->bin_size[i] >= 2000)
+			binned += sm->bin_blocks[i];
+	ct_assert(binned >= 1, "frag api", "free block in histogram");
+	ct_assert(sm->external >= 0.0 && sm->external <= 1.0, "frag api", "external ratio");
+	const t_malloc_frag_type *ti = &fr->types[ZONE_TINY];
+	ct_assert(ti->live_bytes >= 16 && ti->internal >= 6, "frag api", "internal fragmentation");
+#ifndef MALLOC_PERCPU
+	ct_assert((ptr_to_block(q)->flags & BLOCK_F_QUICK) && ti->free_blocks >= 1 &&
+				  ti->bin_blocks[malloc_class_index(16)] >= 1,
+			  "frag api", "quick block counted in place");
+#endif
+	ct_assert(ti->tail_slack <= ti->capacity, "frag api", "tail slack bounded");
+	munmap(fr, sizeof(*fr));
+	free(a);
+	free(c);
+	free(t);
+}
+
+static void test_size_classes(void)
+{
+	size_t count = malloc_class_count();
+	ct_assert(malloc_class_size(count - 1) >= SMALL_MAX && malloc_class_size(count - 2) < SMALL_MAX, "size classes",
+			  "table ends at SMALL_MAX");
+	int ok = 1;
+	for (size_t sz = 1; sz <= SMALL_MAX; ++sz)
+	{
+		size_t c = malloc_class_index(sz), cs = malloc_class_size(c);
+		if (cs < sz || (c && malloc_class_size(c - 1) >= sz))
+			ok = 0; // smallest class that fits ...
+		if (sz <= MALLOC_CLASS_LINEAR_MAX ? cs - sz >= MALLOC_ALIGN : (cs - sz) * 5 >= cs)
+			ok = 0; // ... wasting less than 16 bytes, or less than 20% of it
+		if (malloc_class_floor(sz) > c || malloc_class_size(malloc_class_floor(sz)) > (sz < 16 ? 16 : sz))
+			ok = 0;
+	}
+	ct_assert(ok, "size classes", "index / floor / waste bound");
+#ifdef MALLOC_PERCPU
+	ct_assert(malloc_class_index(PERCPU_MAX_SIZE) + 1 == PERCPU_CLASSES, "size classes", "PERCPU_CLASSES");
+#endif
+	// A freed block between two live ones is handed back whole to the next
+	// request of its class.
+	quick_flush(); // no cached or parked odd-sized block to hand out
+	size_t cls = malloc_class_size(malloc_class_index(TINY_MAX + 1));
+	void *x = malloc(TINY_MAX + 1), *a = malloc(TINY_MAX + 1), *y = malloc(TINY_MAX + 1);
+	ct_assert(malloc_debug_aligned_size(a) == cls, "size classes", "request rounded to its class");
+	size_t stride = sizeof(t_block) + cls;
+	int fenced = (char *)a == (char *)x + stride && (char *)y == (char *)a + stride;
+	free(a);
+	void *b = malloc(cls);
+#ifndef MALLOC_PERCPU
+	ct_assert(!fenced || b == a, "size classes", "same-class reuse");
+#endif
+	(void)fenced;
+	free(b);
+	free(x);
+	free(y);
+}
+
+#ifdef MALLOC_TRACE
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+static void *trace_thread(void *arg)
+{
+	*(long *)arg = syscall(SYS_gettid);
+	void *p = malloc(24);
+	void *q = realloc(p, 100);
+	free(q);
+	return NULL;
+}
+#endif
+
+static void test_trace_recorder(void)
+{
+#ifdef MALLOC_TRACE
+	// The environment is read when a thread records its first call: use a new thread.
+	setenv(MALLOC_TRACE_ENV, "/tmp/ft_malloc_test", 1);
+	long tid = 0;
+	pthread_t th;
+	ct_assert(pthread_create(&th, NULL, trace_thread, &tid) == 0, "trace", "thread started");
+	pthread_join(th, NULL);
+	unsetenv(MALLOC_TRACE_ENV);
+	char path[128];
+	snprintf(path, sizeof(path), "/tmp/ft_malloc_test.%ld.%ld.trace", (long)getpid(), tid);
+	FILE *f = fopen(path, "rb");
+	ct_assert(f != NULL, "trace", "per-thread file created");
+	if (!f)
+		return;
+	t_trace_header h;
+	ct_assert(fread(&h, sizeof(h), 1, f) == 1 && h.magic == MALLOC_TRACE_MAGIC && h.tid == (uint32_t)tid &&
+				  h.record_size == sizeof(t_trace_record),
+			  "trace", "header");
+	fseek(f, (long)MALLOC_TRACE_HEADER_SIZE, SEEK_SET);
+	t_trace_record r, prev[2] = {{0}, {0}};
+	int seen = 0;
+	for (uint64_t i = 0; i < h.count && fread(&r, sizeof(r), 1, f) == 1; ++i)
+	{
+		// malloc(24) -> p, realloc(p, 100) -> q, free(q), with no inner events between.
+		if (r.op == MALLOC_TRACE_FREE && prev[1].op == MALLOC_TRACE_REALLOC && prev[0].op == MALLOC_TRACE_MALLOC &&
+			prev[0].size == 24 && prev[1].ptr == prev[0].result && prev[1].size == 100 && r.ptr == prev[1].result)
+			seen = 1;
+		prev[0] = prev[1];
+		prev[1] = r;
+	}
+	ct_assert(seen, "trace", "malloc/realloc/free sequence recorded");
+	fclose(f);
+	remove(path);
+#endif
+}
+
+#ifdef MALLOC_TRACE
+// Open descriptors, and lines of /proc/self/maps naming a trace file.
+static void trace_resources(size_t *fds, size_t *maps)
+{
+	*fds = 0;
+	*maps = 0;
+	for (int fd = 0; fd < 1024; ++fd)
+		*fds += fcntl(fd, F_GETFD) != -1;
+	char line[512];
+	FILE *f = fopen("/proc/self/maps", "r");
+	while (f && fgets(line, sizeof(line), f))
+		*maps += strstr(line, ".trace") != NULL;
+	if (f)
+		fclose(f);
+}
+#endif
+
+static void test_trace_thread_exit(void)
+{
+#ifdef MALLOC_TRACE
+	enum
+	{
+		N = 8
+	};
+	setenv(MALLOC_TRACE_ENV, "/tmp/ft_malloc_test", 1);
+	size_t fds, maps;
+	trace_resources(&fds, &maps);
+	long tids[N] = {0};
+	pthread_t th[N];
+	for (int i = 0; i < N; ++i)
+		ct_assert(pthread_create(&th[i], NULL, trace_thread, &tids[i]) == 0, "trace exit", "thread started");
+	for (int i = 0; i < N; ++i)
+		pthread_join(th[i], NULL);
+	unsetenv(MALLOC_TRACE_ENV);
+	size_t fds_after, maps_after;
+	trace_resources(&fds_after, &maps_after);
+	ct_assert(fds_after == fds && maps_after == maps, "trace exit", "fd and mappings released");
+	int trimmed = 1;
+	for (int i = 0; i < N; ++i)
+	{
+		char path[128];
+		snprintf(path, sizeof(path), "/tmp/ft_malloc_test.%ld.%ld.trace", (long)getpid(), tids[i]);
+		FILE *f = fopen(path, "rb");
+		t_trace_header h = {0};
+		struct stat st;
+		trimmed &= f && fread(&h, sizeof(h), 1, f) == 1 && stat(path, &st) == 0 &&
+				   (uint64_t)st.st_size == MALLOC_TRACE_HEADER_SIZE + h.count * sizeof(t_trace_record);
+		if (f)
+			fclose(f);
+		remove(path);
+	}
+	ct_assert(trimmed, "trace exit", "files cut back to the last record");
+#endif
+}
+
+#ifdef MALLOC_TRACE
+// Records a little more than one chunk: the second chunk cannot be mapped.
+static void *trace_overflow_thread(void *arg)
+{
+	*(long *)arg = syscall(SYS_gettid);
+	for (size_t i = 0; i < MALLOC_TRACE_CHUNK / 2 + 16; ++i)
+	{
+		void *volatile p = malloc(16);
+		free(p);
+	}
+	return NULL;
+}
+#endif
+
+static void test_trace_stopped(void)
+{
+#ifdef MALLOC_TRACE
+	// Room for the header and one chunk only: growing the file fails (EFBIG,
+	// SIGXFSZ ignored) and the thread stops recording with its file open.
+	struct rlimit old, lim;
+	getrlimit(RLIMIT_FSIZE, &old);
+	lim = old;
+	lim.rlim_cur = MALLOC_TRACE_HEADER_SIZE + MALLOC_TRACE_CHUNK * sizeof(t_trace_record);
+	void (*old_handler)(int) = signal(SIGXFSZ, SIG_IGN);
+	setenv(MALLOC_TRACE_ENV, "/tmp/ft_malloc_test", 1);
+	size_t fds, maps;
+	trace_resources(&fds, &maps);
+	setrlimit(RLIMIT_FSIZE, &lim);
+	long tid = 0;
+	pthread_t th;
+	ct_assert(pthread_create(&th, NULL, trace_overflow_thread, &tid) == 0, "trace stopped", "thread started");
+	pthread_join(th, NULL);
+	setrlimit(RLIMIT_FSIZE, &old);
+	unsetenv(MALLOC_TRACE_ENV);
+	signal(SIGXFSZ, old_handler);
+	size_t fds_after, maps_after;
+	trace_resources(&fds_after, &maps_after);
+	ct_assert(fds_after == fds && maps_after == maps, "trace stopped", "fd and mappings released");
+	char path[128];
+	snprintf(path, sizeof(path), "/tmp/ft_malloc_test.%ld.%ld.trace", (long)getpid(), tid);
+	FILE *f = fopen(path, "rb");
+	t_trace_header h = {0};
+	struct stat st;
+	ct_assert(f && fread(&h, sizeof(h), 1, f) == 1 && h.count == MALLOC_TRACE_CHUNK && stat(path, &st) == 0 &&
+				  (uint64_t)st.st_size == MALLOC_TRACE_HEADER_SIZE + h.count * sizeof(t_trace_record),
+			  "trace stopped", "file cut back to the last record");
+	if (f)
+		fclose(f);
+	remove(path);
+#endif
+}
+
 void add_custom_tests(void)
 {
 	test_register("tiny boundary", test_tiny_boundary);
@@ -183,6 +924,26 @@ void add_custom_tests(void)
 	test_register("split reuse", test_split_reuse);
 	test_register("coalesce chain", test_coalesce_chain);
 	test_register("realloc shrink", test_realloc_shrink);
+	test_register("quick lists", test_quick_lists);
+	test_register("bins zone churn", test_bins_zone_churn);
+	test_register("bin tree", test_bin_tree);
+	test_register("zone growth", test_zone_growth);
+	test_register("reserve", test_reserve);
+	test_register("large layout", test_large_layout);
+	test_register("medium runs", test_medium_runs);
+#ifdef MALLOC_PERCPU
+	test_register("percpu reuse", test_percpu_reuse);
+	test_register("percpu magazines", test_percpu_magazines);
+#endif
+	test_register("lock stats", test_lock_stats);
+	test_register("stats api", test_stats_api);
+	test_register("profile dump", test_profile_dump);
+	test_register("show ex", test_show_ex);
+	test_register("frag api", test_frag_api);
+	test_register("size classes", test_size_classes);
+	test_register("trace", test_trace_recorder);
+	test_register("trace exit", test_trace_thread_exit);
+	test_register("trace stopped", test_trace_stopped);
 }
 
 void show()
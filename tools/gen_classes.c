@@ -0,0 +1,115 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   gen_classes.c                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tamigore <tamigore@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 20:21:05 by tamigore          #+#    #+#             */
+/*   Updated: 2026/10/20 11:44:21 by tamigore         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "malloc_class.h"
+
+// Build-time generator of malloc_class_gen.h: TINY_MAX / SMALL_MAX for the
+// target page size, the size of every class, the size -> class lookup table
+// of TINY/SMALL requests and the class of each power of two up to SMALL_MAX
+// (for compile-time checks of limits such as PERCPU_MAX_SIZE). Run by the Makefile as
+//   gen_classes <page_size> > objects/malloc_class_gen.h
+
+// Thresholds as page-size friendly values:
+//  - TINY_MAX: 128 (historical), rounded up to a divisor of the page size so a
+//    page holds a whole number of maximal TINY payloads.
+//  - SMALL_MAX: 4096 (historical), at least 4 * TINY_MAX, rounded up to a
+//    multiple of the page size.
+static size_t tiny_max(size_t ps)
+{
+	size_t base = 128UL;
+	if (ps <= base)
+		return ALIGN_UP(base, MALLOC_ALIGN);
+	size_t per_page = ps / base;
+	size_t candidate = ALIGN_UP(ps / per_page, MALLOC_ALIGN);
+	while (ps % candidate != 0)
+		candidate += MALLOC_ALIGN;
+	return candidate;
+}
+
+static size_t small_max(size_t ps, size_t tiny)
+{
+	size_t base = 4096UL;
+	if (base < tiny * 4)
+		base = tiny * 4;
+	return ALIGN_UP(base, ps);
+}
+
+// 16-byte steps up to MALLOC_CLASS_LINEAR_MAX, then MALLOC_CLASS_STEPS per octave.
+static size_t class_size(size_t idx)
+{
+	if (idx < MALLOC_CLASS_LINEAR)
+		return (idx + 1) * MALLOC_ALIGN;
+	idx -= MALLOC_CLASS_LINEAR;
+	size_t k = idx / MALLOC_CLASS_STEPS + MALLOC_CLASS_LINEAR_SHIFT;
+	size_t sub = idx % MALLOC_CLASS_STEPS;
+	return (1UL << k) + (sub + 1) * (1UL << (k - MALLOC_CLASS_STEPS_SHIFT));
+}
+
+static void print_list(const char *name, const size_t *v, size_t n)
+{
+	printf("#define %s \\\n\t{", name);
+	for (size_t i = 0; i < n; ++i)
+		printf("%s%zu%s", (i % 16) ? " " : (i ? "\\\n\t " : ""), v[i], i + 1 < n ? "," : "");
+	printf("}\n");
+}
+
+int main(int argc, char **argv)
+{
+	size_t ps = argc > 1 ? strtoul(argv[1], NULL, 10) : 0;
+	if (ps < MALLOC_ALIGN || (ps & (ps - 1)))
+	{
+		fprintf(stderr, "usage: %s <page_size> (a power of two)\n", argv[0]);
+		return 1;
+	}
+	size_t tiny = tiny_max(ps);
+	size_t small = small_max(ps, tiny);
+	size_t sizes[MALLOC_CLASS_MAX];
+	for (size_t i = 0; i < MALLOC_CLASS_MAX; ++i)
+		sizes[i] = class_size(i);
+	if (small > sizes[MALLOC_CLASS_MAX - 1])
+	{
+		fprintf(stderr, "%s: SMALL_MAX %zu is above the last size class\n", argv[0], small);
+		return 1;
+	}
+	size_t lookups = small / MALLOC_ALIGN + 1;
+	size_t *lookup = calloc(lookups, sizeof(size_t));
+	if (!lookup)
+		return 1;
+	size_t count = 0;
+	for (size_t i = 1; i < lookups; ++i)
+	{
+		while (sizes[count] < i * MALLOC_ALIGN)
+			count++;
+		lookup[i] = count;
+	}
+	count++;
+
+	printf("// Generated by tools/gen_classes.c for %zu-byte pages: do not edit.\n", ps);
+	printf("#ifndef MALLOC_CLASS_GEN_H\n#define MALLOC_CLASS_GEN_H\n\n");
+	printf("#define MALLOC_GEN_PAGE_SIZE %zuUL\n", ps);
+	printf("#define MALLOC_GEN_TINY_MAX %zuUL\n", tiny);
+	printf("#define MALLOC_GEN_SMALL_MAX %zuUL\n", small);
+	printf("#define MALLOC_GEN_CLASSES %zu // classes up to SMALL_MAX\n\n", count);
+	printf("// Size of each class (MALLOC_CLASS_MAX entries).\n");
+	print_list("MALLOC_GEN_CLASS_SIZES", sizes, MALLOC_CLASS_MAX);
+	printf("\n// Class of a TINY/SMALL request, indexed by (size + 15) / 16.\n");
+	print_list("MALLOC_GEN_SIZE_CLASS", lookup, lookups);
+	printf("\n// Class of a request of 1 << k bytes, for 1 << k up to SMALL_MAX.\n");
+	for (size_t k = 0; (1UL << k) <= small; ++k)
+		printf("#define MALLOC_GEN_CLASS_POW2_%zu %zu\n", k, lookup[((1UL << k) + MALLOC_ALIGN - 1) / MALLOC_ALIGN]);
+	printf("\n#endif\n");
+	free(lookup);
+	return 0;
+}